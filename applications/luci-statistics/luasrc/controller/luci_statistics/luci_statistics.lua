@@ -25,6 +25,7 @@ function index()
 	local tree = luci.statistics.datatree.Instance()
 
 	-- override entry(): check for existance <plugin>.so where <plugin> is derived from the called path
+	treedepend("/usr/lib/collectd")
 	function _entry( path, ... )
 		local file = path[5] or path[4]
 		if nixio.fs.access( "/usr/lib/collectd/" .. file .. ".so" ) then
@@ -96,14 +97,13 @@ function index()
 		index = index + 1
 	end
 
-	-- output views
+	-- output views, the graph menu follows the collected rrd data and is
+	-- not kept in tree snapshots
 	local page = entry( { "admin", "statistics", "graph" }, template("admin_statistics/index"), _("Graphs"), 80)
 	      page.i18n     = "statistics"
 	      page.setuser  = "nobody"
 	      page.setgroup = "nogroup"
-
-	local vars = luci.http.formvalue(nil, true)
-	local span = vars.timespan or nil
+	      page.nosnapshot = true
 
 	for i, plugin in luci.util.vspairs( tree:plugins() ) do
 
@@ -114,7 +114,7 @@ function index()
 		entry(
 			{ "admin", "statistics", "graph", plugin },
 			call("statistics_render"), labels[plugin], i
-		).query = { timespan = span }
+		)
 
 		-- if more then one instance is found then generate submenu
 		if #instances > 1 then
@@ -123,7 +123,7 @@ function index()
 				entry(
 					{ "admin", "statistics", "graph", plugin, inst },
 					call("statistics_render"), inst, j
-				).query = { timespan = span }
+				)
 			end
 		end
 	end
@@ -191,6 +191,18 @@ function statistics_render()
 	local span  = vars.timespan or uci:get( "luci_statistics", "rrdtool", "default_timespan" ) or spans[1]
 	local graph = luci.statistics.rrdtool.Graph( luci.util.parse_units( span ) )
 
+	-- keep a selected timespan in the graph menu links of this request
+	local function keepspan( node )
+		for _, child in pairs( node.nodes or { } ) do
+			child.query = { timespan = vars.timespan }
+			keepspan( child )
+		end
+	end
+
+	if vars.timespan then
+		keepspan( luci.dispatcher.node( "admin", "statistics", "graph" ) )
+	end
+
 	-- deliver image
 	if vars.img then
 		local l12 = require "luci.ltn12"
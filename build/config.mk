@@ -13,4 +13,8 @@ UVL_SCHEMEDIR = host/lib/uci/schema
 
 HTDOCS = /www
 
+# Static files to store gzip-compressed next to the original when set,
+# e.g. HTDOCS_GZIP = css js htm html svg
+HTDOCS_GZIP =
+
 LUA=$(shell which lua)
@@ -0,0 +1,77 @@
+#!/usr/bin/perl
+#
+# Link all precompiled Lua modules below a module directory into a single
+# module pack as read by nixio.openpack(), see libs/nixio/src/pack.c.
+#
+
+use strict;
+use warnings;
+
+@ARGV == 2 || die "Usage: $0 <module-dir> <pack-file>\n";
+
+my $module_dir = shift @ARGV;
+my $pack_file  = shift @ARGV;
+
+my @crc_table = map {
+	my $c = $_;
+	$c = ( $c & 1 ) ? ( 0xEDB88320 ^ ( $c >> 1 ) ) : ( $c >> 1 ) for 1 .. 8;
+	$c;
+} 0 .. 255;
+
+sub crc32
+{
+	my $crc = 0xFFFFFFFF;
+	$crc = $crc_table[ ( $crc ^ $_ ) & 0xFF ] ^ ( $crc >> 8 ) for unpack 'C*', shift;
+	return $crc ^ 0xFFFFFFFF;
+}
+
+my @entries;
+
+if( open F, "find $module_dir -type f -name '*.lua' -not -name debug.lua -not -path '*/i18n/*' |" )
+{
+	while( defined( my $file = readline F ) )
+	{
+		chomp $file;
+
+		# luci/model/uci.lua -> luci.model.uci, luci/init.lua -> luci
+		( my $name = substr $file, length $module_dir ) =~ s!^/+!!;
+		$name =~ s!(?:/init)?\.lua$!!;
+		$name =~ s!/!.!g;
+
+		open C, "< $file" or die "$file: $!\n";
+		binmode C;
+		my $code = do { local $/; <C> };
+		close C;
+
+		# the image is loaded as binary chunks only
+		$code =~ /^\x1bLua/ || die "$file: not precompiled\n";
+
+		push @entries, { hash => crc32($name), name => $name, code => $code };
+	}
+
+	close F;
+}
+
+exit 0 unless @entries;
+
+@entries = sort { $a->{hash} <=> $b->{hash} } @entries;
+
+my $offset = 12 + 20 * @entries;
+my $index  = 'LUCIPACK' . pack 'V', scalar @entries;
+my $data   = '';
+
+foreach my $e (@entries)
+{
+	$index .= pack 'V5', $e->{hash}, $offset, length $e->{name},
+		$offset + length $e->{name}, length $e->{code};
+
+	$data   .= $e->{name} . $e->{code};
+	$offset += length( $e->{name} ) + length( $e->{code} );
+}
+
+open P, "> $pack_file" or die "$pack_file: $!\n";
+binmode P;
+print P $index, $data;
+close P;
+
+printf "Linked %d modules into %s\n", scalar @entries, $pack_file;
@@ -0,0 +1,41 @@
+#!/usr/bin/lua
+--[[
+LuCI - Template precompiler
+
+Compiles all templates below a view directory into a directory of
+bytecode files which luci.template loads instead of parsing the sources.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+$Id$
+]]--
+
+local template = require "luci.template"
+local util = require "luci.util"
+
+local strip = false
+if arg[1] == "-s" then
+	strip = true
+	table.remove(arg, 1)
+end
+
+if not arg[1] or not arg[2] then
+	util.perror("Usage: %s [-s] path/to/view path/to/view-cache" % arg[0])
+	os.exit(1)
+end
+
+template.viewdir = arg[1]
+
+local count, failed = template.compileall(arg[2], strip)
+
+print("Compiled %d templates into %s" % { count, arg[2] })
+
+for _, name in ipairs(failed) do
+	util.perror("Failed to compile template '%s'" % name)
+end
+
+os.exit(#failed > 0 and 1 or 0)
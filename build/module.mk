@@ -24,6 +24,12 @@ luasource:
 	cp -pR lua/* dist$(LUA_MODULEDIR) 2>/dev/null || true
 	cp -pR htdocs/* dist$(HTDOCS) 2>/dev/null || true
 	for i in $$(find dist -name .svn -o -name .gitignore); do rm -rf $$i || true; done
+  ifneq ($(HTDOCS_GZIP),)
+	for i in $$(find dist$(HTDOCS) -type f \( $(patsubst %,-name '*.%' -o,$(HTDOCS_GZIP)) -false \)); do \
+	  gzip -9 -n -c $$i > $$i.gz; \
+	  if [ $$(wc -c < $$i.gz) -ge $$(wc -c < $$i) ]; then rm -f $$i.gz; fi; \
+	done
+  endif
   ifneq ($(PO),)
 	mkdir -p dist$(LUCI_I18NDIR)
 	for file in $(PO); do \
@@ -41,6 +47,12 @@ luastrip: luasource
 luacompile: luasource
 	for i in $$(find dist -name *.lua -not -name debug.lua| sort); do if ! $(LUAC) $(LUAC_OPTIONS) -o $$i $$i; then echo "Error compiling $$i"; exit 1; fi; done
 
+luaimage: luacompile
+	mkdir -p dist$(LUCI_LIBRARYDIR)/preload
+	perl $(MAKEPATH)mkluapack.pl dist$(LUA_MODULEDIR) \
+		dist$(LUCI_LIBRARYDIR)/preload/$(notdir $(patsubst %/,%,$(dir $(CURDIR))))-$(notdir $(CURDIR)).pack
+	rmdir dist$(LUCI_LIBRARYDIR)/preload 2>/dev/null || true
+
 luaclean:
 	rm -rf dist
 
@@ -13,74 +13,153 @@ http://www.apache.org/licenses/LICENSE-2.0
 $Id$
 ]]--
 
-local io = require "io"
+local os = require "os"
 local fs = require "nixio.fs"
 local util = require "luci.util"
 local nixio = require "nixio"
 local debug = require "debug"
 local string = require "string"
+local table = require "table"
+local math = require "math"
 local package = require "package"
 
-local type, loadfile = type, loadfile
+local type, pairs, ipairs, next = type, pairs, ipairs, next
+local newproxy, getmetatable = newproxy, getmetatable
 
 
 module "luci.ccache"
 
+-- Writes the pack when collected on state close
+local sentinel
+
 function cache_ondemand(...)
 	if debug.getinfo(1, 'S').source ~= "=?" then
 		cache_enable(...)
 	end
 end
 
+-- Encode a number as 32 bit little endian integer.
+local function _u32(n)
+	return string.char(n % 256, math.floor(n / 256) % 256,
+		math.floor(n / 65536) % 256, math.floor(n / 16777216) % 256)
+end
+
+-- Write a module pack, see nixio.openpack() for the layout.
+local function _write_pack(file, mode, modules)
+	local index = {}
+	for name, code in pairs(modules) do
+		local hash = nixio.bin.crc32(name)
+		index[#index+1] = {
+			hash = hash < 0 and hash + 4294967296 or hash,
+			name = name, code = code
+		}
+	end
+	table.sort(index, function(a, b) return a.hash < b.hash end)
+
+	local head = { "LUCIPACK", _u32(#index) }
+	local data = { }
+	local offset = 12 + 20 * #index
+
+	for _, e in ipairs(index) do
+		head[#head+1] = _u32(e.hash) .. _u32(offset) .. _u32(#e.name)
+			.. _u32(offset + #e.name) .. _u32(#e.code)
+		data[#data+1] = e.name
+		data[#data+1] = e.code
+		offset = offset + #e.name + #e.code
+	end
+
+	-- the pack is replaced atomically, running processes keep their mapping
+	local tmp = file .. "." .. nixio.getpid()
+	local fp = nixio.open(tmp, "w", mode)
+	if fp then
+		local ok = fp:writeall(table.concat(head) .. table.concat(data))
+		fp:close()
+		if not ok or not fs.rename(tmp, file) then
+			fs.unlink(tmp)
+		end
+	end
+end
+
 function cache_enable(cachepath, mode)
-	cachepath = cachepath or "/tmp/luci-modulecache"
+	cachepath = cachepath or "/tmp/luci-modulecache.pack"
 	mode = mode or "r--r--r--"
 
 	local loader = package.loaders[2]
-	local uid    = nixio.getpid("uid")
-
-	if not fs.stat(cachepath) then
-		fs.mkdir(cachepath)
+	local uid    = nixio.getuid()
+	local pack, sources
+	local fresh  = { }
+
+	-- The "" entry of the pack maps module names to the path and mtime of
+	-- the source they were compiled from.
+	local stat = fs.stat(cachepath)
+	if stat and stat.uid == uid and stat.modestr == mode then
+		pack = nixio.openpack(cachepath)
+		sources = pack and pack:load("")
+		sources = sources and sources()
+
+		if pack and not sources then
+			pack:close()
+			pack = nil
+		end
 	end
 
-	local function _encode_filename(name)
-		local encoded = ""
-		for i=1, #name do
-			encoded = encoded .. ("%2X" % string.byte(name, i))
+	-- Load a module from the pack unless its source changed.
+	local function _load_packed(mod)
+		local src = pack and mod ~= "" and sources[mod]
+		if src and fs.stat(src[1], "mtime") == src[2] then
+			return pack:load(mod)
 		end
-		return encoded
 	end
 
-	local function _load_sane(file)
-		local stat = fs.stat(file)
-		if stat and stat.uid == uid and stat.mode == mode then
-			return loadfile(file)
+	-- Modules loaded from source are merged into a new pack once the
+	-- state is closed.
+	local function _flush()
+		if not next(fresh) or nixio.getuid() ~= uid then
+			return
 		end
-	end
 
-	local function _write_sane(file, func)
-		if nixio.getuid() == uid then
-			local fp = io.open(file, "w")
-			if fp then
-				fp:write(util.get_bytecode(func))
-				fp:close()
-				fs.chmod(file, mode)
+		local now = os.time()
+		local modules = { }
+		local srcinfo = { }
+
+		if pack then
+			for _, name in ipairs(pack:names()) do
+				local func = name ~= "" and sources[name] and pack:load(name)
+				if func then
+					modules[name] = string.dump(func)
+					srcinfo[name] = sources[name]
+				end
 			end
 		end
+
+		for name, func in pairs(fresh) do
+			local file = debug.getinfo(func, "S").source:match("^@(.+)")
+			local mtime = file and fs.stat(file, "mtime")
+			if mtime then
+				-- a change within the current second would go unnoticed
+				srcinfo[name] = { file, mtime < now and mtime or -1 }
+				modules[name] = util.get_bytecode(func)
+			end
+		end
+
+		modules[""] = util.get_bytecode(srcinfo)
+
+		_write_pack(cachepath, mode, modules)
 	end
 
+	sentinel = newproxy(true)
+	getmetatable(sentinel).__gc = _flush
+
 	package.loaders[2] = function(mod)
-		local encoded = cachepath .. "/" .. _encode_filename(mod)
-		local modcons = _load_sane(encoded)
-		
+		local modcons = _load_packed(mod)
 		if modcons then
 			return modcons
 		end
 
-		-- No cachefile
+		-- Not packed or outdated
 		modcons = loader(mod)
 		if type(modcons) == "function" then
-			_write_sane(encoded, modcons)
+			fresh[mod] = modcons
 		end
 		return modcons
 	end
@@ -0,0 +1,55 @@
+--[[
+LuCI - Lua Configuration Interface
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+$Id$
+]]--
+
+local fs = require "nixio.fs"
+local nixio = require "nixio"
+local table = require "table"
+local package = require "package"
+
+local ipairs = ipairs
+
+
+--- LuCI precompiled module images.
+-- Packages built with LUA_TARGET=image ship a module pack of all their
+-- precompiled modules, see build/mkluapack.pl.
+module "luci.preload"
+
+imagedir = "/usr/lib/lua/luci/preload"
+
+--- Serve modules from the installed module images.
+-- The loader takes precedence over the modules in the package path, an
+-- image is installed and upgraded together with the modules it contains.
+-- @param path	Image directory (optional)
+-- @return		Number of images
+function enable(path)
+	local images = { }
+	local files = nixio.openpack and fs.glob((path or imagedir) .. "/*.pack")
+
+	if files then
+		for file in files do
+			images[#images+1] = nixio.openpack(file)
+		end
+	end
+
+	if #images > 0 then
+		table.insert(package.loaders, 2, function(mod)
+			for _, image in ipairs(images) do
+				local modcons = image:load(mod)
+				if modcons then
+					return modcons
+				end
+			end
+		end)
+	end
+
+	return #images
+end
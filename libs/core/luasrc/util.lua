@@ -195,7 +195,7 @@ end
 -- @param value	String value containing the data to escape
 -- @return		String value containing the escaped data
 function pcdata(value)
-	return value and tparser.sanitize_pcdata(tostring(value))
+	return value and tparser.pcdata(tostring(value))
 end
 
 --- Strip HTML tags from given string.
@@ -22,10 +22,13 @@
 
 #include <sys/stat.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <unistd.h>
 #include <stdio.h>
+#include <fcntl.h>
 #include <errno.h>
+#include <time.h>
 #include <glob.h>
 
 #include <lualib.h>
@@ -34,6 +37,8 @@
 
 #define MODNAME        "luci.fastindex"
 #define DEFAULT_BUFLEN 1024
+#define HASH_SIZE      64
+#define CACHE_MAGIC    "FIDX0001"
 
 //#define DEBUG 1
 
@@ -43,22 +48,17 @@
 #define DPRINTF(...) do {} while (0)
 #endif
 
-/**
- * list_for_each_offset	-	iterate over a list, start with the provided pointer
- * @pos:	the &struct list_head to use as a loop cursor.
- * @head:	the head for your list.
- */
-#define list_for_each_offset(pos, head, offset) \
-	for (pos = (offset)->next; pos != (offset); \
-	     pos = ((pos->next == (head)) && ((offset) != (head)) ? (head)->next : pos->next))
-
 static char *namespace = NULL;
 
 struct fastindex_entry {
 	struct list_head list;
+	struct hlist_node hash;
 	time_t timestamp;
 	int checked;
 	char *name;
+	char *namespace;
+	char *code;
+	size_t codelen;
 };
 
 struct fastindex_pattern {
@@ -66,13 +66,23 @@ struct fastindex_pattern {
 	char pattern[];
 };
 
+/* directory watched for changes while running from the cache */
+struct fastindex_dir {
+	struct list_head list;
+	time_t timestamp;
+	char path[];
+};
+
 struct fastindex {
-	lua_State *L;
+	lua_State *S;
 	int checked;
+	int dirty;
 	char *func;
+	char *cache;
 	struct list_head patterns;
-	struct list_head *last;
 	struct list_head entries;
+	struct list_head dirs;
+	struct hlist_head hash[HASH_SIZE];
 	int ofs;
 	char *buf;
 	int buflen;
@@ -103,17 +113,25 @@ fastindex_module(lua_State *L)
 	return 0;
 }
 
-static struct fastindex_entry *
-find_entry(struct fastindex *f, char *name)
+static unsigned int
+hash_name(const char *name)
 {
-	struct list_head *p;
+	unsigned int h = 5381;
 
-	if (!f->last)
-		f->last = &f->entries;
+	while (*name)
+		h = (h << 5) + h + (unsigned char) *name++;
 
-	list_for_each_offset(p, &f->entries, f->last) {
-		struct fastindex_entry *e;
-		e = container_of(p, struct fastindex_entry, list);
+	return h % HASH_SIZE;
+}
+
+static struct fastindex_entry *
+find_entry(struct fastindex *f, const char *name)
+{
+	struct fastindex_entry *e;
+	struct hlist_node *p;
+
+	for (p = f->hash[hash_name(name)].first; p; p = p->next) {
+		e = hlist_entry(p, struct fastindex_entry, hash);
 		if (!strcmp(e->name, name))
 			return e;
 	}
@@ -121,7 +139,7 @@ find_entry(struct fastindex *f, char *name)
 }
 
 static struct fastindex_entry *
-new_entry(struct fastindex *f, char *name)
+new_entry(struct fastindex *f, const char *name)
 {
 	struct fastindex_entry *e;
 
@@ -135,7 +153,8 @@ new_entry(struct fastindex *f, char *name)
 		free(e);
 		goto error;
 	}
-	INIT_LIST_HEAD(&e->list);
+	list_add_tail(&e->list, &f->entries);
+	hlist_add_head(&e->hash, &f->hash[hash_name(name)]);
 
 	return e;
 
@@ -146,10 +165,272 @@ error:
 static void free_entry(struct fastindex_entry *e)
 {
 	list_del(&e->list);
+	hlist_del(&e->hash);
 	free(e->name);
+	free(e->namespace);
+	free(e->code);
 	free(e);
 }
 
+static void
+add_dir(struct fastindex *f, const char *path, size_t len)
+{
+	struct fastindex_dir *d;
+	struct list_head *p;
+	struct stat st;
+
+	list_for_each(p, &f->dirs) {
+		d = container_of(p, struct fastindex_dir, list);
+		if (strlen(d->path) == len && !strncmp(d->path, path, len))
+			return;
+	}
+
+	d = malloc(sizeof(struct fastindex_dir) + len + 1);
+	if (!d)
+		return;
+
+	memcpy(d->path, path, len);
+	d->path[len] = 0;
+	d->timestamp = stat(d->path, &st) ? 0 : st.st_mtime;
+	list_add_tail(&d->list, &f->dirs);
+}
+
+static void
+free_dirs(struct fastindex *f)
+{
+	struct list_head *p, *tmp;
+
+	list_for_each_safe(p, tmp, &f->dirs) {
+		list_del(p);
+		free(container_of(p, struct fastindex_dir, list));
+	}
+}
+
+/* check whether a file was added to or removed from a watched directory */
+static int
+dirs_changed(struct fastindex *f)
+{
+	struct fastindex_dir *d;
+	struct list_head *p;
+	struct stat st;
+
+	if (list_empty(&f->dirs))
+		return 1;
+
+	list_for_each(p, &f->dirs) {
+		d = container_of(p, struct fastindex_dir, list);
+		if (stat(d->path, &st) || st.st_mtime != d->timestamp)
+			return 1;
+	}
+	return 0;
+}
+
+/* watch the static part of the patterns and the directories of all entries */
+static void
+update_dirs(struct fastindex *f)
+{
+	struct list_head *p;
+	const char *s, *wc;
+	time_t now;
+
+	free_dirs(f);
+	now = time(NULL);
+	list_for_each(p, &f->patterns) {
+		struct fastindex_pattern *pt = container_of(p, struct fastindex_pattern, list);
+		wc = strpbrk(pt->pattern, "*?[");
+		for (s = wc ? wc : pt->pattern + strlen(pt->pattern); s > pt->pattern && *s != '/'; s--);
+		if (s > pt->pattern)
+			add_dir(f, pt->pattern, s - pt->pattern + 1);
+	}
+	list_for_each(p, &f->entries) {
+		struct fastindex_entry *e = container_of(p, struct fastindex_entry, list);
+		s = strrchr(e->name, '/');
+		if (s)
+			add_dir(f, e->name, s - e->name + 1);
+	}
+
+	/* changes within the current second could still go unnoticed */
+	list_for_each(p, &f->dirs) {
+		struct fastindex_dir *d = container_of(p, struct fastindex_dir, list);
+		if (d->timestamp >= now)
+			d->timestamp = 0;
+	}
+}
+
+static int
+cache_read(FILE *fp, void *buf, size_t len)
+{
+	return (fread(buf, 1, len, fp) == len) ? 0 : -1;
+}
+
+static int
+cache_readstr(FILE *fp, char **str, size_t *len)
+{
+	uint32_t l;
+
+	*str = NULL;
+	if (cache_read(fp, &l, sizeof(l)))
+		return -1;
+	if (l == UINT32_MAX)
+		return 0;
+
+	*str = malloc(l + 1);
+	if (!*str || cache_read(fp, *str, l))
+		return -1;
+
+	(*str)[l] = 0;
+	if (len)
+		*len = l;
+	return 0;
+}
+
+static void
+cache_writestr(FILE *fp, const char *str, size_t len)
+{
+	uint32_t l = str ? len : UINT32_MAX;
+
+	fwrite(&l, sizeof(l), 1, fp);
+	if (str)
+		fwrite(str, 1, len, fp);
+}
+
+/**
+ * Restore the entries and watched directories of a previous process
+ */
+static int
+cache_load(struct fastindex *f)
+{
+	struct fastindex_entry *e;
+	struct list_head *p, *tmp;
+	struct stat st;
+	char magic[sizeof(CACHE_MAGIC) - 1];
+	char *str;
+	uint32_t i, n;
+	int64_t ts;
+	size_t len;
+	FILE *fp;
+	int fd;
+
+	fd = open(f->cache, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	/* only trust bytecode written by ourselves */
+	if (fstat(fd, &st) || st.st_uid != geteuid() || (st.st_mode & 077)) {
+		close(fd);
+		return -1;
+	}
+
+	fp = fdopen(fd, "r");
+	if (!fp) {
+		close(fd);
+		return -1;
+	}
+
+	if (cache_read(fp, magic, sizeof(magic)) ||
+	    memcmp(magic, CACHE_MAGIC, sizeof(magic)))
+		goto error;
+
+	if (cache_read(fp, &n, sizeof(n)))
+		goto error;
+	for (i = 0; i < n; i++) {
+		if (cache_read(fp, &ts, sizeof(ts)) || cache_readstr(fp, &str, &len) || !str) {
+			free(str);
+			goto error;
+		}
+		add_dir(f, str, len);
+		container_of(f->dirs.prev, struct fastindex_dir, list)->timestamp = ts;
+		free(str);
+	}
+
+	if (cache_read(fp, &n, sizeof(n)))
+		goto error;
+	for (i = 0; i < n; i++) {
+		if (cache_read(fp, &ts, sizeof(ts)) || cache_readstr(fp, &str, NULL) || !str) {
+			free(str);
+			goto error;
+		}
+		e = find_entry(f, str) ? NULL : new_entry(f, str);
+		free(str);
+		if (!e)
+			goto error;
+
+		e->timestamp = ts;
+		if (cache_readstr(fp, &e->namespace, NULL) ||
+		    cache_readstr(fp, &e->code, &e->codelen))
+			goto error;
+	}
+
+	fclose(fp);
+	return 0;
+
+error:
+	fclose(fp);
+	free_dirs(f);
+	list_for_each_safe(p, tmp, &f->entries) {
+		free_entry(container_of(p, struct fastindex_entry, list));
+	}
+	return -1;
+}
+
+/**
+ * Write the entries and watched directories for the next process
+ */
+static void
+cache_save(struct fastindex *f)
+{
+	struct list_head *p;
+	char *tmp;
+	uint32_t n;
+	int64_t ts;
+	FILE *fp;
+	int fd;
+
+	tmp = malloc(strlen(f->cache) + 16);
+	if (!tmp)
+		return;
+
+	sprintf(tmp, "%s.%d", f->cache, (int) getpid());
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	fp = (fd < 0) ? NULL : fdopen(fd, "w");
+	if (!fp) {
+		if (fd >= 0)
+			close(fd);
+		free(tmp);
+		return;
+	}
+
+	fwrite(CACHE_MAGIC, 1, sizeof(CACHE_MAGIC) - 1, fp);
+
+	n = 0;
+	list_for_each(p, &f->dirs)
+		n++;
+	fwrite(&n, sizeof(n), 1, fp);
+	list_for_each(p, &f->dirs) {
+		struct fastindex_dir *d = container_of(p, struct fastindex_dir, list);
+		ts = d->timestamp;
+		fwrite(&ts, sizeof(ts), 1, fp);
+		cache_writestr(fp, d->path, strlen(d->path));
+	}
+
+	n = 0;
+	list_for_each(p, &f->entries)
+		n++;
+	fwrite(&n, sizeof(n), 1, fp);
+	list_for_each(p, &f->entries) {
+		struct fastindex_entry *e = container_of(p, struct fastindex_entry, list);
+		ts = e->timestamp;
+		fwrite(&ts, sizeof(ts), 1, fp);
+		cache_writestr(fp, e->name, strlen(e->name));
+		cache_writestr(fp, e->namespace, e->namespace ? strlen(e->namespace) : 0);
+		cache_writestr(fp, e->code, e->codelen);
+	}
+
+	if (fclose(fp) || rename(tmp, f->cache))
+		unlink(tmp);
+	free(tmp);
+}
+
 int bufferwriter(lua_State *L, const void *p, size_t sz, void *ud)
 {
 	struct fastindex *f = ud;
@@ -168,10 +449,62 @@ int bufferwriter(lua_State *L, const void *p, size_t sz, void *ud)
 	return 0;
 }
 
+/**
+ * Publish the index function of an entry in the indexes table on top of
+ * the stack
+ */
 static void
-load_index(struct fastindex *f, struct fastindex_entry *e)
+push_index(lua_State *L, struct fastindex_entry *e)
 {
-	lua_State *L;
+	if (!e->code)
+		return;
+
+	if (luaL_loadbuffer(L, e->code, e->codelen, e->name)) {
+		lua_pop(L, 1);
+		return;
+	}
+
+	lua_createtable(L, (e->namespace ? 2 : 1), 0);
+	lua_insert(L, -2);
+	lua_rawseti(L, -2, 1);
+	if (e->namespace) {
+		lua_pushstring(L, e->namespace);
+		lua_rawseti(L, -2, 2);
+	}
+	lua_setfield(L, -2, e->name);
+}
+
+/**
+ * Create the state all controllers are loaded in, each file gets a fresh
+ * environment falling back to the globals
+ */
+static lua_State *
+sandbox(struct fastindex *f)
+{
+	if (f->S)
+		return f->S;
+
+	f->S = luaL_newstate();
+	if (!f->S)
+		return NULL;
+
+	luaL_openlibs(f->S);
+	lua_pushcfunction(f->S, fastindex_module);
+	lua_setfield(f->S, LUA_GLOBALSINDEX, "module");
+
+	lua_createtable(f->S, 0, 1);
+	lua_pushvalue(f->S, LUA_GLOBALSINDEX);
+	lua_setfield(f->S, -2, "__index");
+	lua_setfield(f->S, LUA_REGISTRYINDEX, MODNAME ".env");
+
+	return f->S;
+}
+
+static void
+load_index(lua_State *L, struct fastindex *f, struct fastindex_entry *e)
+{
+	lua_State *S;
+	char *code;
 
 	DPRINTF("Loading module: %s\n", e->name);
 
@@ -179,53 +512,87 @@ load_index(struct fastindex *f, struct fastindex_entry *e)
 		f->buf = malloc(f->buflen);
 
 	if (!f->buf)
-		luaL_error(f->L, "Out of memory!\n");
+		luaL_error(L, "Out of memory!\n");
 
 	f->ofs = 0;
-	L = luaL_newstate();
-	if (!L)
+	S = sandbox(f);
+	if (!S)
 		return;
 
+	free(namespace);
 	namespace = NULL;
-	luaL_openlibs(L);
-	lua_pushcfunction(L, fastindex_module);
-	lua_setfield(L, LUA_GLOBALSINDEX, "module");
 
 	do {
-		if (luaL_dofile(L, e->name)) {
+		if (luaL_loadfile(S, e->name)) {
+			DPRINTF("Warning: unable to open module '%s'\n", e->name);
+			break;
+		}
+
+		lua_newtable(S);
+		lua_getfield(S, LUA_REGISTRYINDEX, MODNAME ".env");
+		lua_setmetatable(S, -2);
+		lua_pushvalue(S, -1);
+		lua_setfenv(S, -3);
+		lua_insert(S, -2);
+
+		if (lua_pcall(S, 0, 0, 0)) {
 			DPRINTF("Warning: unable to open module '%s'\n", e->name);
 			break;
 		}
 
-		lua_getglobal(L, f->func);
-		lua_dump(L, bufferwriter, f);
+		lua_pushstring(S, f->func);
+		lua_rawget(S, -2);
+		if (!lua_isfunction(S, -1) || lua_iscfunction(S, -1))
+			break;
+
+		lua_dump(S, bufferwriter, f);
 		DPRINTF("Got %d bytes\n", f->ofs);
 		if (f->ofs == 0)
 			break;
-		lua_createtable(f->L, (namespace ? 2 : 1), 0);
-		luaL_loadbuffer(f->L, f->buf, f->ofs, "tmp");
-		lua_rawseti(f->L, -2, 1);
-		if (namespace) {
-			DPRINTF("Module has namespace '%s'\n", namespace);
-			lua_pushstring(f->L, namespace);
-			lua_rawseti(f->L, -2, 2);
-			free(namespace);
-			namespace = NULL;
-		}
-		lua_setfield(f->L, -2, e->name);
+
+		code = malloc(f->ofs);
+		if (!code)
+			break;
+
+		memcpy(code, f->buf, f->ofs);
+		free(e->code);
+		free(e->namespace);
+		e->code = code;
+		e->codelen = f->ofs;
+		e->namespace = namespace;
+		namespace = NULL;
+		if (e->namespace)
+			DPRINTF("Module has namespace '%s'\n", e->namespace);
+
+		push_index(L, e);
+		f->dirty = 1;
 	} while (0);
 
-	lua_close(L);
+	lua_settop(S, 0);
+	free(namespace);
+	namespace = NULL;
 }
 
+/* reload an entry if its file was modified */
+static void
+check_entry(lua_State *L, struct fastindex *f, struct fastindex_entry *e, struct stat *st)
+{
+	e->checked = f->checked;
+	if ((e->timestamp < st->st_mtime)) {
+		load_index(L, f, e);
+		e->timestamp = st->st_mtime;
+		f->dirty = 1;
+	}
+}
 
 static int
 fastindex_scan(lua_State *L)
 {
 	struct list_head *tmp, *p;
 	struct fastindex *f;
+	struct stat st;
 	glob_t gl;
-	int i;
+	int i, known = 0;
 	int gl_flags = GLOB_NOESCAPE | GLOB_NOSORT | GLOB_MARK;
 
 	f = to_fastindex(L);
@@ -236,44 +603,73 @@ fastindex_scan(lua_State *L)
 		return 0;
 
 	lua_getfield(L, lua_upvalueindex(1), "indexes");
-	list_for_each(p, &f->patterns) {
-		struct fastindex_pattern *pt = container_of(p, struct fastindex_pattern, list);
-		glob(pt->pattern, gl_flags, NULL, &gl);
-		gl_flags |= GLOB_APPEND;
+
+	/* a new process starts from the cache and skips the glob as long as
+	 * no controller was added to or removed from the watched directories */
+	if (f->checked == 1 && f->cache && !cache_load(f)) {
+		list_for_each(p, &f->entries) {
+			push_index(L, container_of(p, struct fastindex_entry, list));
+		}
+
+		if (dirs_changed(f))
+			f->dirty = 1;
+		else
+			known = 1;
 	}
-	for (i = 0; i < gl.gl_pathc; i++) {
-		struct fastindex_entry *e;
-		struct stat st;
 
-		if (stat(gl.gl_pathv[i], &st))
-			continue;
+	if (known) {
+		/* the set of files is unchanged, modifications are still checked */
+		list_for_each(p, &f->entries) {
+			struct fastindex_entry *e = container_of(p, struct fastindex_entry, list);
 
-		if ((st.st_mode & S_IFMT) != S_IFREG)
-			continue;
+			if (stat(e->name, &st) || (st.st_mode & S_IFMT) != S_IFREG)
+				continue;
 
-		e = find_entry(f, gl.gl_pathv[i]);
-		if (!e) {
-			e = new_entry(f, gl.gl_pathv[i]);
-			list_add_tail(&e->list, &f->entries);
+			check_entry(L, f, e, &st);
 		}
+	} else {
+		list_for_each(p, &f->patterns) {
+			struct fastindex_pattern *pt = container_of(p, struct fastindex_pattern, list);
+			glob(pt->pattern, gl_flags, NULL, &gl);
+			gl_flags |= GLOB_APPEND;
+		}
+		for (i = 0; i < gl.gl_pathc; i++) {
+			struct fastindex_entry *e;
+
+			if (stat(gl.gl_pathv[i], &st))
+				continue;
 
-		e->checked = f->checked;
-		if ((e->timestamp < st.st_mtime)) {
-			load_index(f, e);
-			e->timestamp = st.st_mtime;
+			if ((st.st_mode & S_IFMT) != S_IFREG)
+				continue;
+
+			e = find_entry(f, gl.gl_pathv[i]);
+			if (!e) {
+				e = new_entry(f, gl.gl_pathv[i]);
+				if (!e)
+					continue;
+			}
+
+			check_entry(L, f, e, &st);
 		}
+		globfree(&gl);
 	}
-	globfree(&gl);
 	list_for_each_safe(p, tmp, &f->entries) {
 		struct fastindex_entry *e = container_of(p, struct fastindex_entry, list);
 		if (e->checked < f->checked) {
-			lua_pushnil(f->L);
-			lua_setfield(f->L, -2, e->name);
+			lua_pushnil(L);
+			lua_setfield(L, -2, e->name);
 			free_entry(e);
+			f->dirty = 1;
 		}
 	}
 	lua_pop(L, 1);
 
+	if (f->cache && f->dirty) {
+		update_dirs(f);
+		cache_save(f);
+	}
+	f->dirty = 0;
+
 	return 0;
 }
 
@@ -295,6 +691,12 @@ fastindex_free(lua_State *L)
 		e = container_of(p, struct fastindex_entry, list);
 		free_entry(e);
 	}
+	free_dirs(f);
+	if (f->S)
+		lua_close(f->S);
+	free(f->buf);
+	free(f->func);
+	free(f->cache);
 	return 0;
 }
 
@@ -331,9 +733,10 @@ static int
 fastindex_new(lua_State *L)
 {
 	struct fastindex *f;
-	const char *func;
+	const char *func, *cache;
 
 	func = luaL_checkstring(L, 1);
+	cache = luaL_optstring(L, 2, NULL);
 
 	f = lua_newuserdata(L, sizeof(struct fastindex));
 	lua_createtable(L, 0, 2);
@@ -351,17 +754,15 @@ fastindex_new(lua_State *L)
 	luaI_openlib(L, NULL, fastindex_m, 1);
 
 	memset(f, 0, sizeof(struct fastindex));
-	f->L = L;
 	f->buflen = DEFAULT_BUFLEN;
 	INIT_LIST_HEAD(&f->entries);
 	INIT_LIST_HEAD(&f->patterns);
+	INIT_LIST_HEAD(&f->dirs);
 
 	f->func = strdup(func);
-	if (!f->func) {
-		if (f->func)
-			free(f->func);
+	f->cache = cache ? strdup(cache) : NULL;
+	if (!f->func || (cache && !f->cache))
 		luaL_error(L, "Out of memory\n");
-	}
 
 	return 1;
 }
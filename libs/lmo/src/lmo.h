@@ -39,12 +39,12 @@
 #endif
 
 
+/* on-disk index record, all fields are stored in network byte order */
 struct lmo_entry {
 	uint32_t key_id;
 	uint32_t val_id;
 	uint32_t offset;
 	uint32_t length;
-	struct lmo_entry *next;
 } __attribute__((packed));
 
 typedef struct lmo_entry lmo_entry_t;
@@ -52,21 +52,51 @@ typedef struct lmo_entry lmo_entry_t;
 
 struct lmo_archive {
 	int         fd;
+	int         sorted;
 	uint32_t    length;
+	uint32_t    size;
+	uint32_t    count;
 	lmo_entry_t *index;
 	char        *mmap;
+	int         catalogs;	/* number of catalogs referencing the mmap */
 };
 
 typedef struct lmo_archive lmo_archive_t;
 
 
+struct lmo_catalog_slot {
+	uint32_t   key_id;
+	uint32_t   length;
+	const char *value;
+};
+
+typedef struct lmo_catalog_slot lmo_catalog_slot_t;
+
+
+/* merged open addressing table over several archives, the archives must
+ * stay open for the lifetime of the catalog */
+struct lmo_catalog {
+	uint32_t           count;
+	uint32_t           mask;
+	lmo_catalog_slot_t *slots;
+};
+
+typedef struct lmo_catalog lmo_catalog_t;
+
+
 uint32_t sfh_hash(const char * data, int len);
 
 char _lmo_error[1024];
 const char * lmo_error(void);
 
 lmo_archive_t * lmo_open(const char *file);
+lmo_entry_t * lmo_find(lmo_archive_t *ar, uint32_t key_id);
 int lmo_lookup(lmo_archive_t *ar, const char *key, char *dest, int len);
 void lmo_close(lmo_archive_t *ar);
 
+lmo_catalog_t * lmo_catalog_new(void);
+int lmo_catalog_add(lmo_catalog_t *cat, lmo_archive_t *ar);
+lmo_catalog_slot_t * lmo_catalog_find(lmo_catalog_t *cat, uint32_t key_id);
+void lmo_catalog_free(lmo_catalog_t *cat);
+
 #endif
@@ -20,16 +20,6 @@
 
 extern char _lmo_error[1024];
 
-static int lmo_read32( int fd, uint32_t *val )
-{
-	if( read(fd, val, 4) < 4 )
-		return -1;
-
-	*val = ntohl(*val);
-
-	return 4;
-}
-
 static char * error(const char *message, int add_errno)
 {
 	memset(_lmo_error, 0, sizeof(_lmo_error));
@@ -52,11 +42,10 @@ lmo_archive_t * lmo_open(const char *file)
 {
 	int in = -1;
 	uint32_t idx_offset = 0;
-	uint32_t i;
+	uint32_t i, prev;
 	struct stat s;
 
 	lmo_archive_t *ar    = NULL;
-	lmo_entry_t   *head  = NULL;
 	lmo_entry_t   *entry = NULL;
 
 	if( stat(file, &s) == -1 )
@@ -71,70 +60,62 @@ lmo_archive_t * lmo_open(const char *file)
 		goto cleanup;
 	}
 
-	if( lseek(in, -sizeof(uint32_t), SEEK_END) == -1 )
-	{
-		error("Can not seek to eof", 1);
-		goto cleanup;
-	}
-
-	if( lmo_read32(in, &idx_offset) != 4 )
+	if( s.st_size < sizeof(uint32_t) )
 	{
 		error("Unexpected EOF while reading index offset", 0);
 		goto cleanup;
 	}
 
-	if( lseek(in, (off_t)idx_offset, SEEK_SET) == -1 )
-	{
-		error("Can not seek to index offset", 1);
-		goto cleanup;
-	}
-
 	if( (ar = (lmo_archive_t *) malloc(sizeof(lmo_archive_t))) != NULL )
 	{
-		ar->fd     = in;
-		ar->length = idx_offset;
+		memset(ar, 0, sizeof(lmo_archive_t));
+
+		ar->fd   = in;
+		ar->size = s.st_size;
 
 		fcntl(ar->fd, F_SETFD, fcntl(ar->fd, F_GETFD) | FD_CLOEXEC);
 
-		for( i = idx_offset;
-		     i < (s.st_size - sizeof(uint32_t));
-		     i += (4 * sizeof(uint32_t))
-		) {
-			if( (entry = (lmo_entry_t *) malloc(sizeof(lmo_entry_t))) != NULL )
-			{
-				if( (lmo_read32(ar->fd, &entry->key_id) == 4) &&
-				    (lmo_read32(ar->fd, &entry->val_id) == 4) &&
-				    (lmo_read32(ar->fd, &entry->offset) == 4) &&
-				    (lmo_read32(ar->fd, &entry->length) == 4)
-				) {
-					entry->next = head;
-					head = entry;
-				}
-				else
-				{
-					error("Unexpected EOF while reading index entry", 0);
-					goto cleanup;
-				}
-			}
-			else
-			{
-				error("Out of memory", 0);
-				goto cleanup;
-			}
+		if( (ar->mmap = mmap(NULL, ar->size, PROT_READ, MAP_PRIVATE, ar->fd, 0)) == MAP_FAILED )
+		{
+			error("Failed to memory map archive contents", 1);
+			goto cleanup;
 		}
 
-		ar->index = head;
+		memcpy(&idx_offset, ar->mmap + ar->size - sizeof(uint32_t), sizeof(uint32_t));
+		idx_offset = ntohl(idx_offset);
 
-		if( lseek(ar->fd, 0, SEEK_SET) == -1 )
+		if( (idx_offset > (ar->size - sizeof(uint32_t))) ||
+		    ((ar->size - sizeof(uint32_t) - idx_offset) % sizeof(lmo_entry_t)) )
 		{
-			error("Can not seek to start", 1);
+			error("Invalid index offset", 0);
 			goto cleanup;
 		}
 
-		if( (ar->mmap = mmap(NULL, ar->length, PROT_READ, MAP_PRIVATE, ar->fd, 0)) == MAP_FAILED )
+		ar->length = idx_offset;
+		ar->index  = (lmo_entry_t *) (ar->mmap + idx_offset);
+		ar->count  = (ar->size - sizeof(uint32_t) - idx_offset) / sizeof(lmo_entry_t);
+		ar->sorted = 1;
+
+		/*
+		 * The index is used in place from the mmap. Archives written by
+		 * current po2lmo versions carry an index sorted by key_id which
+		 * allows bisecting it, older ones are scanned linearly.
+		 */
+		for( i = 0, prev = 0; i < ar->count; i++ )
 		{
-			error("Failed to memory map archive contents", 1);
-			goto cleanup;
+			entry = &ar->index[i];
+
+			if( (ntohl(entry->offset) > ar->length) ||
+			    (ntohl(entry->length) > (ar->length - ntohl(entry->offset))) )
+			{
+				error("Index entry points beyond archive contents", 0);
+				goto cleanup;
+			}
+
+			if( ntohl(entry->key_id) < prev )
+				ar->sorted = 0;
+
+			prev = ntohl(entry->key_id);
 		}
 
 		return ar;
@@ -151,24 +132,10 @@ lmo_archive_t * lmo_open(const char *file)
 	if( in > -1 )
 		close(in);
 
-	if( head != NULL )
-	{
-		entry = head;
-
-		while( entry != NULL )
-		{
-			head = entry->next;
-			free(entry);
-			entry = head;
-		}
-
-		head = entry = NULL;
-	}
-
 	if( ar != NULL )
 	{
 		if( (ar->mmap != NULL) && (ar->mmap != MAP_FAILED) )
-			munmap(ar->mmap, ar->length);
+			munmap(ar->mmap, ar->size);
 
 		free(ar);
 		ar = NULL;
@@ -179,24 +146,10 @@ lmo_archive_t * lmo_open(const char *file)
 
 void lmo_close(lmo_archive_t *ar)
 {
-	lmo_entry_t *head  = NULL;
-	lmo_entry_t *entry = NULL;
-
 	if( ar != NULL )
 	{
-		entry = ar->index;
-
-		while( entry != NULL )
-		{
-			head = entry->next;
-			free(entry);
-			entry = head;
-		}
-
-		head = entry = NULL;
-
 		if( (ar->mmap != NULL) && (ar->mmap != MAP_FAILED) )
-			munmap(ar->mmap, ar->length);
+			munmap(ar->mmap, ar->size);
 
 		close(ar->fd);
 		free(ar);
@@ -205,6 +158,44 @@ void lmo_close(lmo_archive_t *ar)
 	}
 }
 
+lmo_entry_t * lmo_find(lmo_archive_t *ar, uint32_t key_id)
+{
+	uint32_t i, lo, hi, mid;
+	lmo_entry_t *entry = NULL;
+
+	if( !ar || !ar->count )
+		return NULL;
+
+	/* unsorted index is in reverse po order, scan backwards */
+	if( !ar->sorted )
+	{
+		for( i = ar->count; i > 0; i-- )
+			if( ntohl(ar->index[i-1].key_id) == key_id )
+				return &ar->index[i-1];
+
+		return NULL;
+	}
+
+	/* find the leftmost match so duplicate keys resolve like before */
+	lo = 0;
+	hi = ar->count;
+
+	while( lo < hi )
+	{
+		mid = lo + ((hi - lo) / 2);
+
+		if( ntohl(ar->index[mid].key_id) < key_id )
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if( (lo < ar->count) && (ntohl(ar->index[lo].key_id) == key_id) )
+		entry = &ar->index[lo];
+
+	return entry;
+}
+
 int lmo_lookup(lmo_archive_t *ar, const char *key, char *dest, int len)
 {
 	uint32_t look_key = sfh_hash(key, strlen(key));
@@ -214,21 +205,131 @@ int lmo_lookup(lmo_archive_t *ar, const char *key, char *dest, int len)
 	if( !ar )
 		return copy_len;
 
-	entry = ar->index;
+	if( (entry = lmo_find(ar, look_key)) != NULL )
+	{
+		copy_len = ((len - 1) > ntohl(entry->length)) ? ntohl(entry->length) : (len - 1);
+		memcpy(dest, &ar->mmap[ntohl(entry->offset)], copy_len);
+		dest[copy_len] = '\0';
+	}
+
+	return copy_len;
+}
+
 
-	while( entry != NULL )
+lmo_catalog_t * lmo_catalog_new(void)
+{
+	lmo_catalog_t *cat;
+
+	if( (cat = (lmo_catalog_t *) malloc(sizeof(lmo_catalog_t))) != NULL )
 	{
-		if( entry->key_id == look_key )
-		{
-			copy_len = ((len - 1) > entry->length) ? entry->length : (len - 1);
-			memcpy(dest, &ar->mmap[entry->offset], copy_len);
-			dest[copy_len] = '\0';
+		cat->count = 0;
+		cat->mask  = 0;
+		cat->slots = NULL;
+
+		return cat;
+	}
+
+	error("Out of memory", 0);
+	return NULL;
+}
+
+static lmo_catalog_slot_t * lmo_catalog_probe(lmo_catalog_slot_t *slots,
+                                              uint32_t mask, uint32_t key_id)
+{
+	uint32_t i = key_id & mask;
+
+	while( (slots[i].value != NULL) && (slots[i].key_id != key_id) )
+		i = (i + 1) & mask;
+
+	return &slots[i];
+}
+
+static int lmo_catalog_grow(lmo_catalog_t *cat, uint32_t count)
+{
+	uint32_t i, size = 64;
+	lmo_catalog_slot_t *slots, *slot;
+
+	/* keep the load factor at or below 0.5 */
+	while( size < (count * 2) )
+		size *= 2;
+
+	if( cat->slots && (size <= (cat->mask + 1)) )
+		return 0;
+
+	if( (slots = calloc(size, sizeof(lmo_catalog_slot_t))) == NULL )
+	{
+		error("Out of memory", 0);
+		return -1;
+	}
 
-			break;
+	for( i = 0; cat->slots && (i <= cat->mask); i++ )
+	{
+		if( cat->slots[i].value != NULL )
+		{
+			slot = lmo_catalog_probe(slots, size - 1, cat->slots[i].key_id);
+			*slot = cat->slots[i];
 		}
+	}
+
+	free(cat->slots);
+
+	cat->slots = slots;
+	cat->mask  = size - 1;
+
+	return 0;
+}
+
+int lmo_catalog_add(lmo_catalog_t *cat, lmo_archive_t *ar)
+{
+	uint32_t i, n;
+	lmo_entry_t *entry;
+	lmo_catalog_slot_t *slot;
+
+	if( !cat || !ar )
+		return -1;
+
+	if( lmo_catalog_grow(cat, cat->count + ar->count) )
+		return -1;
+
+	/*
+	 * Keys already present win, so archives added first take precedence.
+	 * Walk each archive in the order lmo_find() would prefer duplicates.
+	 */
+	for( n = 0; n < ar->count; n++ )
+	{
+		i = ar->sorted ? n : (ar->count - n - 1);
+		entry = &ar->index[i];
+		slot = lmo_catalog_probe(cat->slots, cat->mask, ntohl(entry->key_id));
 
-		entry = entry->next;
+		if( slot->value == NULL )
+		{
+			slot->key_id = ntohl(entry->key_id);
+			slot->length = ntohl(entry->length);
+			slot->value  = &ar->mmap[ntohl(entry->offset)];
+			cat->count++;
+		}
 	}
 
-	return copy_len;
+	return 0;
+}
+
+lmo_catalog_slot_t * lmo_catalog_find(lmo_catalog_t *cat, uint32_t key_id)
+{
+	lmo_catalog_slot_t *slot;
+
+	if( !cat || !cat->slots )
+		return NULL;
+
+	slot = lmo_catalog_probe(cat->slots, cat->mask, key_id);
+
+	return (slot->value != NULL) ? slot : NULL;
+}
+
+void lmo_catalog_free(lmo_catalog_t *cat)
+{
+	if( cat != NULL )
+	{
+		free(cat->slots);
+		free(cat);
+	}
 }
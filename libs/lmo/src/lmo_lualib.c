@@ -68,28 +68,23 @@ static lmo_luaentry_t *_lmo_push_entry(lua_State *L) {
 }
 
 static int _lmo_lookup(lua_State *L, lmo_archive_t *ar, uint32_t hash) {
-	lmo_entry_t *e = ar->index;
+	lmo_entry_t *e = lmo_find(ar, hash);
 	lmo_luaentry_t *le = NULL;
 
-	while( e != NULL )
+	if( e != NULL )
 	{
-		if( e->key_id == hash )
+		if( (le = _lmo_push_entry(L)) != NULL )
 		{
-			if( (le = _lmo_push_entry(L)) != NULL )
-			{
-				le->archive = ar;
-				le->entry   = e;
-				return 1;
-			}
-			else
-			{
-				lua_pushnil(L);
-				lua_pushstring(L, "out of memory");
-				return 2;
-			}
+			le->archive = ar;
+			le->entry   = e;
+			return 1;
+		}
+		else
+		{
+			lua_pushnil(L);
+			lua_pushstring(L, "out of memory");
+			return 2;
 		}
-
-		e = e->next;
 	}
 
 	lua_pushnil(L);
@@ -111,23 +106,44 @@ static int lmo_L_lookup(lua_State *L) {
 
 static int lmo_L_foreach(lua_State *L) {
 	lmo_archive_t **ar = luaL_checkudata(L, 1, LMO_ARCHIVE_META);
-	lmo_entry_t *e = (*ar)->index;
+	lmo_entry_t *e;
+	uint32_t i;
 
 	if( lua_isfunction(L, 2) )
 	{
-		while( e != NULL )
+		for( i = 0; i < (*ar)->count; i++ )
 		{
+			e = &(*ar)->index[i];
 			lua_pushvalue(L, 2);
-			lua_pushinteger(L, e->key_id);
-			lua_pushlstring(L, &(*ar)->mmap[e->offset], e->length);
+			lua_pushinteger(L, ntohl(e->key_id));
+			lua_pushlstring(L, &(*ar)->mmap[ntohl(e->offset)], ntohl(e->length));
 			lua_pcall(L, 2, 0, 0);
-			e = e->next;
 		}
 	}
 
 	return 0;
 }
 
+static int lmo_L_close(lua_State *L) {
+	lmo_archive_t **ar = luaL_checkudata(L, 1, LMO_ARCHIVE_META);
+
+	/* catalog slots point into the mmap of the archive */
+	if( (*ar) != NULL && (*ar)->catalogs > 0 )
+	{
+		lua_pushnil(L);
+		lua_pushstring(L, "archive is in use by a catalog");
+		return 2;
+	}
+
+	if( (*ar) != NULL )
+		lmo_close(*ar);
+
+	*ar = NULL;
+
+	lua_pushboolean(L, 1);
+	return 1;
+}
+
 static int lmo_L__gc(lua_State *L) {
 	lmo_archive_t **ar = luaL_checkudata(L, 1, LMO_ARCHIVE_META);
 
@@ -150,8 +166,8 @@ static int _lmo_convert_entry(lua_State *L, int idx) {
 	lmo_luaentry_t *le = luaL_checkudata(L, idx, LMO_ENTRY_META);
 
 	lua_pushlstring(L,
-		&le->archive->mmap[le->entry->offset],
-		le->entry->length
+		&le->archive->mmap[ntohl(le->entry->offset)],
+		ntohl(le->entry->length)
 	);
 
 	return 1;
@@ -179,7 +195,7 @@ static int lmo_L_entry__concat(lua_State *L) {
 
 static int lmo_L_entry__len(lua_State *L) {
 	lmo_luaentry_t *le = luaL_checkudata(L, 1, LMO_ENTRY_META);
-	lua_pushinteger(L, le->entry->length);
+	lua_pushinteger(L, ntohl(le->entry->length));
 	return 1;
 }
 
@@ -191,9 +207,199 @@ static int lmo_L_entry__gc(lua_State *L) {
 }
 
 
+/*
+ * The catalog userdata carries an environment table holding the added
+ * archive objects at [1] (to keep their mmaps alive) and a key -> string
+ * memo at [2]; misses are memoized as false.
+ */
+static int lmo_L_catalog(lua_State *L) {
+	lmo_catalog_t *cat, **udata;
+
+	if( (cat = lmo_catalog_new()) != NULL )
+	{
+		if( (udata = lua_newuserdata(L, sizeof(lmo_catalog_t *))) != NULL )
+		{
+			*udata = cat;
+			luaL_getmetatable(L, LMO_CATALOG_META);
+			lua_setmetatable(L, -2);
+
+			lua_createtable(L, 2, 0);
+			lua_newtable(L);
+			lua_rawseti(L, -2, 1);
+			lua_newtable(L);
+			lua_rawseti(L, -2, 2);
+			lua_setfenv(L, -2);
+
+			return 1;
+		}
+
+		lmo_catalog_free(cat);
+	}
+
+	lua_pushnil(L);
+	lua_pushstring(L, "out of memory");
+	return 2;
+}
+
+static int lmo_L_catalog_add(lua_State *L) {
+	lmo_catalog_t **cat = luaL_checkudata(L, 1, LMO_CATALOG_META);
+	lmo_archive_t **ar  = luaL_checkudata(L, 2, LMO_ARCHIVE_META);
+
+	if( (*ar) == NULL )
+		return luaL_argerror(L, 2, "archive is closed");
+
+	if( lmo_catalog_add(*cat, *ar) )
+	{
+		lua_pushnil(L);
+		lua_pushstring(L, lmo_error());
+		return 2;
+	}
+
+	(*ar)->catalogs++;
+
+	lua_getfenv(L, 1);
+
+	lua_rawgeti(L, -1, 1);
+	lua_pushvalue(L, 2);
+	lua_rawseti(L, -2, lua_objlen(L, -2) + 1);
+	lua_pop(L, 1);
+
+	/* previously memoized misses may now resolve */
+	lua_newtable(L);
+	lua_rawseti(L, -2, 2);
+
+	lua_pushboolean(L, 1);
+	return 1;
+}
+
+/* push the translation of the string at kidx or nil */
+static void _lmo_catalog_lookup(lua_State *L, int cidx, int kidx) {
+	lmo_catalog_t **cat = luaL_checkudata(L, cidx, LMO_CATALOG_META);
+	lmo_catalog_slot_t *slot;
+	size_t len;
+	const char *key;
+
+	lua_getfenv(L, cidx);
+	lua_rawgeti(L, -1, 2);
+	lua_pushvalue(L, kidx);
+	lua_rawget(L, -2);
+
+	if( lua_isnil(L, -1) )
+	{
+		lua_pop(L, 1);
+
+		key  = lua_tolstring(L, kidx, &len);
+		slot = lmo_catalog_find(*cat, sfh_hash(key, len));
+
+		if( slot != NULL )
+			lua_pushlstring(L, slot->value, slot->length);
+		else
+			lua_pushboolean(L, 0);
+
+		lua_pushvalue(L, kidx);
+		lua_pushvalue(L, -2);
+		lua_rawset(L, -4);
+	}
+
+	if( !lua_toboolean(L, -1) )
+	{
+		lua_pop(L, 1);
+		lua_pushnil(L);
+	}
+
+	lua_replace(L, -3);
+	lua_pop(L, 1);
+}
+
+static int lmo_L_catalog_lookup(lua_State *L) {
+	luaL_checkudata(L, 1, LMO_CATALOG_META);
+	luaL_checkstring(L, 2);
+	_lmo_catalog_lookup(L, 1, 2);
+	return 1;
+}
+
+static int lmo_L_catalog_get(lua_State *L) {
+	lmo_catalog_t **cat = luaL_checkudata(L, 1, LMO_CATALOG_META);
+	uint32_t hash = (uint32_t) luaL_checkinteger(L, 2);
+	lmo_catalog_slot_t *slot = lmo_catalog_find(*cat, hash);
+
+	if( slot != NULL )
+		lua_pushlstring(L, slot->value, slot->length);
+	else
+		lua_pushnil(L);
+
+	return 1;
+}
+
+static int lmo_L_catalog__len(lua_State *L) {
+	lmo_catalog_t **cat = luaL_checkudata(L, 1, LMO_CATALOG_META);
+	lua_pushinteger(L, (*cat)->count);
+	return 1;
+}
+
+static int lmo_L_catalog__tostring(lua_State *L) {
+	lmo_catalog_t **cat = luaL_checkudata(L, 1, LMO_CATALOG_META);
+	lua_pushfstring(L, "LMO Catalog (%d entries)", (*cat)->count);
+	return 1;
+}
+
+static int lmo_L_catalog__gc(lua_State *L) {
+	lmo_catalog_t **cat = luaL_checkudata(L, 1, LMO_CATALOG_META);
+	lmo_archive_t **ar;
+	int i;
+
+	/* release the archives, they may have been collected already */
+	lua_getfenv(L, 1);
+	lua_rawgeti(L, -1, 1);
+
+	for( i = 1; i <= lua_objlen(L, -1); i++ )
+	{
+		lua_rawgeti(L, -1, i);
+		ar = lua_touserdata(L, -1);
+
+		if( ar != NULL && (*ar) != NULL )
+			(*ar)->catalogs--;
+
+		lua_pop(L, 1);
+	}
+
+	lua_pop(L, 2);
+
+	if( (*cat) != NULL )
+		lmo_catalog_free(*cat);
+
+	*cat = NULL;
+
+	return 0;
+}
+
+/* lmo.lookup(key, catalog, ...) - probe catalogs in order, nil ones are skipped */
+static int lmo_L_lookup_chain(lua_State *L) {
+	int i, top = lua_gettop(L);
+
+	luaL_checkstring(L, 1);
+
+	for( i = 2; i <= top; i++ )
+	{
+		if( lua_isnil(L, i) )
+			continue;
+
+		_lmo_catalog_lookup(L, i, 1);
+
+		if( !lua_isnil(L, -1) )
+			return 1;
+
+		lua_pop(L, 1);
+	}
+
+	lua_pushnil(L);
+	return 1;
+}
+
+
 /* lmo method table */
 static const luaL_reg M[] = {
-	{"close",		lmo_L__gc},
+	{"close",		lmo_L_close},
 	{"get",			lmo_L_get},
 	{"lookup",		lmo_L_lookup},
 	{"foreach",		lmo_L_foreach},
@@ -211,10 +417,23 @@ static const luaL_reg E[] = {
 	{NULL,			NULL}
 };
 
+/* lmo.catalog method table */
+static const luaL_reg C[] = {
+	{"add",			lmo_L_catalog_add},
+	{"get",			lmo_L_catalog_get},
+	{"lookup",		lmo_L_catalog_lookup},
+	{"__len",		lmo_L_catalog__len},
+	{"__tostring",	lmo_L_catalog__tostring},
+	{"__gc",		lmo_L_catalog__gc},
+	{NULL,			NULL}
+};
+
 /* module table */
 static const luaL_reg R[] = {
 	{"open",	lmo_L_open},
 	{"hash",	lmo_L_hash},
+	{"catalog",	lmo_L_catalog},
+	{"lookup",	lmo_L_lookup_chain},
 	{NULL,		NULL}
 };
 
@@ -231,6 +450,12 @@ LUALIB_API int luaopen_lmo(lua_State *L) {
 	lua_setfield(L, -2, "__index");
 	lua_setglobal(L, LMO_ENTRY_META);	
 
+	luaL_newmetatable(L, LMO_CATALOG_META);
+	luaL_register(L, NULL, C);
+	lua_pushvalue(L, -1);
+	lua_setfield(L, -2, "__index");
+	lua_setglobal(L, LMO_CATALOG_META);
+
 	luaL_register(L, LMO_LUALIB_META, R);
 
 	return 1;
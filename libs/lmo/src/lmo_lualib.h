@@ -28,6 +28,7 @@
 #define LMO_LUALIB_META  "lmo"
 #define LMO_ARCHIVE_META "lmo.archive"
 #define LMO_ENTRY_META   "lmo.entry"
+#define LMO_CATALOG_META "lmo.catalog"
 
 struct lmo_luaentry {
 	lmo_archive_t *archive;  
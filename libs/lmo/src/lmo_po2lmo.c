@@ -36,6 +36,27 @@ static void print(const void *ptr, size_t size, size_t nmemb, FILE *stream)
 		die("Failed to write stdout");
 }
 
+static int cmp_index(const void *a, const void *b)
+{
+	const lmo_entry_t *x = a;
+	const lmo_entry_t *y = b;
+
+	if( x->key_id != y->key_id )
+		return (x->key_id < y->key_id) ? -1 : 1;
+
+	/* keep po order for colliding keys */
+	if( x->offset != y->offset )
+		return (x->offset < y->offset) ? -1 : 1;
+
+	return 0;
+}
+
+static void print_uint32(uint32_t x, FILE *out)
+{
+	uint32_t y = htonl(x);
+	print(&y, sizeof(uint32_t), 1, out);
+}
+
 static int extract_string(const char *src, char *dest, int len)
 {
 	int pos = 0;
@@ -84,12 +105,15 @@ int main(int argc, char *argv[])
 	int state  = 0;
 	int offset = 0;
 	int length = 0;
+	int n_entries = 0;
+	int n_alloc = 0;
+	int i;
 	uint32_t key_id, val_id;
 
 	FILE *in;
 	FILE *out;
 
-	lmo_entry_t *head  = NULL;
+	lmo_entry_t *index = NULL;
 	lmo_entry_t *entry = NULL;
 
 	if( (argc != 3) || ((in = fopen(argv[1], "r")) == NULL) || ((out = fopen(argv[2], "w")) == NULL) )
@@ -160,26 +184,25 @@ int main(int argc, char *argv[])
 
 				if( key_id != val_id )
 				{
-					if( (entry = (lmo_entry_t *) malloc(sizeof(lmo_entry_t))) != NULL )
+					if( n_entries >= n_alloc )
 					{
-						memset(entry, 0, sizeof(entry));
-						length = strlen(val) + ((4 - (strlen(val) % 4)) % 4);
+						n_alloc = n_alloc ? (n_alloc * 2) : 256;
+						index = realloc(index, n_alloc * sizeof(lmo_entry_t));
 
-						entry->key_id = htonl(key_id);
-						entry->val_id = htonl(val_id);
-						entry->offset = htonl(offset);
-						entry->length = htonl(strlen(val));
+						if( index == NULL )
+							die("Out of memory");
+					}
 
-						print(val, length, 1, out);
-						offset += length;
+					entry = &index[n_entries++];
+					length = strlen(val) + ((4 - (strlen(val) % 4)) % 4);
 
-						entry->next = head;
-						head = entry;
-					}
-					else
-					{
-						die("Out of memory");
-					}
+					entry->key_id = key_id;
+					entry->val_id = val_id;
+					entry->offset = offset;
+					entry->length = strlen(val);
+
+					print(val, length, 1, out);
+					offset += length;
 				}
 			}
 
@@ -191,16 +214,20 @@ int main(int argc, char *argv[])
 		memset(line, 0, sizeof(line));
 	}
 
-	entry = head;
-	while( entry != NULL )
+	/* emit the index sorted by key_id so lmo_find() can bisect it */
+	if( n_entries > 0 )
+		qsort(index, n_entries, sizeof(lmo_entry_t), cmp_index);
+
+	for( i = 0; i < n_entries; i++ )
 	{
-		print(&entry->key_id, sizeof(uint32_t), 1, out);
-		print(&entry->val_id, sizeof(uint32_t), 1, out);
-		print(&entry->offset, sizeof(uint32_t), 1, out);
-		print(&entry->length, sizeof(uint32_t), 1, out);
-		entry = entry->next;
+		print_uint32(index[i].key_id, out);
+		print_uint32(index[i].val_id, out);
+		print_uint32(index[i].offset, out);
+		print_uint32(index[i].length, out);
 	}
 
+	free(index);
+
 	if( offset > 0 )
 	{
 		offset = htonl(offset);
@@ -14,7 +14,7 @@ $Id$
 
 ]]--
 
-local ipairs, type, tonumber = ipairs, type, tonumber
+local ipairs, pairs, type, tonumber, next = ipairs, pairs, type, tonumber, next
 local os = require "os"
 local nixio = require "nixio", require "nixio.util"
 local fs = require "nixio.fs"
@@ -32,6 +32,88 @@ local cond = require "luci.http.protocol.conditionals"
 -- @cstyle instance
 module "luci.lucid.http.handler.file"
 
+-- Open file cache, shared by all handlers of the process. Entries are keyed
+-- by physical request path and representation and invalidated through
+-- inotify, without inotify nothing is cached.
+local CACHESIZE = 64
+local cache, ccount, watches = {}, 0, {}
+local inotify, inotify_pid
+
+local function cache_drop(key)
+	local entry = cache[key]
+	if entry then
+		cache[key], ccount = nil, ccount - 1
+		watches[entry.wd][key] = nil
+		if not next(watches[entry.wd]) then
+			watches[entry.wd] = nil
+			fs.inotify_rm(inotify, entry.wd)
+		end
+		entry.fd:close()
+	end
+end
+
+local function cache_sync()
+	-- the cache of a parent process is not inherited
+	local pid = nixio.getpid()
+	if inotify_pid ~= pid then
+		for key, entry in pairs(cache) do
+			entry.fd:close()
+		end
+		if inotify then
+			inotify:close()
+		end
+		cache, ccount, watches = {}, 0, {}
+		inotify, inotify_pid = fs.inotify and fs.inotify(), pid
+	end
+
+	if not inotify then
+		return false
+	end
+
+	local events = fs.inotify_read(inotify)
+	while events do
+		for _, ev in ipairs(events) do
+			for key in pairs(watches[ev.wd] or {}) do
+				cache_drop(key)
+			end
+		end
+		events = fs.inotify_read(inotify)
+	end
+	return true
+end
+
+local function cache_add(key, entry)
+	if ccount >= CACHESIZE then
+		for k in pairs(cache) do
+			cache_drop(k)
+		end
+	end
+
+	entry.wd = fs.inotify_add(inotify, entry.file,
+		"modify", "attrib", "move_self", "delete_self")
+	if entry.wd then
+		watches[entry.wd] = watches[entry.wd] or {}
+		watches[entry.wd][key] = true
+		cache[key], ccount = entry, ccount + 1
+		return true
+	end
+end
+
+-- Check whether the client accepts gzip encoded content.
+local function accepts_gzip(header)
+	for coding, q in (header or ""):gmatch("([%w%*-]+)[^,]*;%s*q=([%d.]+)") do
+		if (coding == "gzip" or coding == "x-gzip") and tonumber(q) == 0 then
+			return false
+		end
+	end
+	for coding in (header or ""):gmatch("([%w-]+)") do
+		if coding == "gzip" or coding == "x-gzip" then
+			return true
+		end
+	end
+	return false
+end
+
 --- Create a simple file system handler.
 -- @class function
 -- @param name Name
@@ -48,6 +130,7 @@ function Simple.__init__(self, name, docroot, options)
 	options = options or {}
 	self.dirlist = not options.noindex
 	self.error404 = options.error404
+	self.gzip = not options.nogzip
 end
 
 --- Parse a range request.
@@ -101,73 +184,115 @@ function Simple.getfile(self, uri)
 	return file, fs.stat(file)
 end
 
+--- Translate path and return an opened regular file.
+-- Repeated requests are served from the open file cache.
+-- @param uri Request URI
+-- @param gzip Look up the precompressed ".gz" sibling instead (optional)
+-- @return file entry or nil, physical file path, file information, error
+function Simple.getentry(self, uri, gzip)
+	if gzip then
+		uri = uri .. ".gz"
+	end
+
+	-- a negotiated ".gz" sibling and a direct request for it are served with
+	-- different headers and must not share an entry
+	local key = self.docroot .. uri .. (gzip and "\0gzip" or "")
+	local caching = cache_sync()
+	if cache[key] then
+		return cache[key]
+	end
+
+	local file, stat = self:getfile(uri)
+	if not stat or stat.type ~= "reg" then
+		return nil, file, stat
+	end
+
+	local f, err = nixio.open(file)
+	if not f then
+		return nil, file, stat, err
+	end
+
+	local entry = {
+		file = file,
+		stat = stat,
+		fd = f,
+		etag = cond.mk_etag( stat ),
+		mime = mime.to_mime( gzip and file:sub(1, -4) or file ),
+		mtime = date.to_http( stat.mtime ),
+		gzip = gzip
+	}
+	entry.cached = caching and cache_add(key, entry)
+	return entry
+end
+
 --- Handle a GET request.
 -- @param request Request object
 -- @return status code, header table, response source
 function Simple.handle_GET(self, request)
-	local file, stat = self:getfile(prot.urldecode(request.env.PATH_INFO, true))
+	local uri = prot.urldecode(request.env.PATH_INFO, true)
+	local gzip = self.gzip and accepts_gzip(request.env.HTTP_ACCEPT_ENCODING)
+	local entry, file, stat, err = gzip and self:getentry(uri, true)
+	if not entry then
+		entry, file, stat, err = self:getentry(uri)
+	end
 
-	if stat then
-		if stat.type == "reg" then
+	if entry then
+		stat = entry.stat
 
-			-- Generate Entity Tag
-			local etag = cond.mk_etag( stat )
-
-			-- Check conditionals
-			local ok, code, hdrs
-
-			ok, code, hdrs = cond.if_modified_since( request, stat )
-			if ok then
-				ok, code, hdrs = cond.if_match( request, stat )
-				if ok then
-					ok, code, hdrs = cond.if_unmodified_since( request, stat )
-					if ok then
-						ok, code, hdrs = cond.if_none_match( request, stat )
-						if ok then
-							local f, err = nixio.open(file)
-
-							if f then
-								local code = 200
-								local o, s, r = self:parse_range(request, stat.size)
-
-								if not o then
-									return self:failure(416, "Invalid Range")
-								end
-
-								local headers = {
-									["Last-Modified"]  = date.to_http( stat.mtime ),
-									["Content-Type"]   = mime.to_mime( file ),
-									["ETag"]           = etag,
-									["Accept-Ranges"]  = "bytes",
-								}
-
-								if o == true then
-									s = stat.size
-								else
-									code = 206
-									headers["Content-Range"] = r
-									f:seek(o)
-								end
-								
-								headers["Content-Length"] = s
-
-								-- Send Response
-								return code, headers, srv.IOResource(f, s)
-							else
-								return self:failure( 403, err:gsub("^.+: ", "") )
-							end
-						else
-							return code, hdrs
-						end
-					else
-						return code, hdrs
-					end
-				else
-					return code, hdrs
-				end
-			else
+		-- Check conditionals
+		local ok, code, hdrs = cond.if_modified_since( request, stat )
+		if ok then
+			ok, code, hdrs = cond.if_match( request, stat )
+		end
+		if ok then
+			ok, code, hdrs = cond.if_unmodified_since( request, stat )
+		end
+		if ok then
+			ok, code, hdrs = cond.if_none_match( request, stat )
+		end
+
+		local o, s, r = ok and self:parse_range(request, stat.size)
+		if not o then
+			if not entry.cached then
+				entry.fd:close()
+			end
+			if not ok then
 				return code, hdrs
 			end
+			return self:failure(416, "Invalid Range")
+		end
+
+		local code = 200
+		local headers = {
+			["Last-Modified"]  = entry.mtime,
+			["Content-Type"]   = entry.mime,
+			["ETag"]           = entry.etag,
+			["Accept-Ranges"]  = "bytes",
+		}
+
+		if entry.gzip then
+			headers["Content-Encoding"] = "gzip"
+		end
+		if self.gzip then
+			headers["Vary"] = "Accept-Encoding"
+		end
+
+		if o == true then
+			o, s = 0, stat.size
+		else
+			code = 206
+			headers["Content-Range"] = r
+		end
+		
+		headers["Content-Length"] = s
+
+		-- Send Response
+		return code, headers, srv.IOResource(entry.fd, s, o, entry.cached)
+
+	elseif stat then
+		if stat.type == "reg" then
+
+			return self:failure( 403, err:gsub("^.+: ", "") )
 
 		elseif stat.type == "dir" then
 
@@ -34,6 +34,8 @@ function Luci.__init__(self, name, prefix)
 	srv.Handler.__init__(self, name)
 	self.prefix = prefix
 	dsp.indexcache = "/tmp/luci-indexcache"
+	dsp.treecache = "/tmp/luci-treecache"
+	dsp.lazytree = true
 end
 
 --- Handle a HEAD request.
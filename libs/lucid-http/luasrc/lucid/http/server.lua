@@ -53,11 +53,37 @@ statusmsg = {
 -- @class function
 -- @param fd File descriptor
 -- @param len Length of data
+-- @param offset Offset of the data in the file (optional)
+-- @param persistent Keep the descriptor open after sending (optional)
 -- @return IO resource
 IOResource = util.class()
 
-function IOResource.__init__(self, fd, len)
-	self.fd, self.len = fd, len
+function IOResource.__init__(self, fd, len, offset, persistent)
+	self.fd, self.len, self.offset = fd, len, offset
+	self.persistent = persistent
+end
+
+--- Send the resource to a client.
+-- Plain sockets are served with a single sendfile_range() call that does not
+-- change the file offset, so persistent descriptors can be shared.
+-- @param client client socket
+-- @return true or nil, error code, error message
+function IOResource.send(self, client)
+	if self.offset and nixio.sendfile_range and client:is_socket() then
+		local sent, code, msg, part = nixio.sendfile_range(client, self.fd,
+			self.offset, self.len, 5000)
+		if sent and sent < self.len then
+			return nil, -1, "file truncated"
+		elseif sent or part > 0 or (code ~= nixio.const.ENOSYS
+		 and code ~= nixio.const.EINVAL) then
+			return sent, code, msg
+		end
+	end
+
+	if self.offset then
+		self.fd:seek(self.offset)
+	end
+	return self.fd:copyz(client, self.len)
 end
 
 
@@ -288,7 +314,19 @@ local function chunksource(sock, buffer)
 end
 
 -- Create a sink that chunk-encodes data and writes it on a given socket.
+-- Plain sockets use the nixio encoder which coalesces small chunks.
 local function chunksink(sock)
+	if nixio.chunked and sock:is_socket() then
+		local encoder = nixio.chunked(sock)
+		return function(chunk, err)
+			if not chunk then
+				return encoder:finish()
+			else
+				return encoder:write(tostring(chunk))
+			end
+		end
+	end
+
 	return function(chunk, err)
 		if not chunk then
 			return sock:writeall("0\r\n\r\n")
@@ -355,6 +393,47 @@ local hdr2env = {
 	["User-Agent"] = "HTTP_USER_AGENT"
 }
 
+-- Maximum size of the request line and headers
+local HEADERLIMIT = 16384
+
+-- Create a request object from the request line and a header table.
+local function mkrequest(method, uri, protocol, headers)
+	local env = {
+		REQUEST_METHOD = method,
+		REQUEST_URI = uri,
+		SERVER_PROTOCOL = protocol
+	}
+	for key, val in pairs(headers) do
+		if hdr2env[key] then
+			env[hdr2env[key]] = val
+		end
+	end
+	env.SCRIPT_NAME, env.QUERY_STRING = uri:match("([^?]*)%??(.*)")
+	return {env = env, headers = headers}
+end
+
+--- Read and parse the request headers and prepare the environment.
+-- The headers are parsed in C, any data following them is left in the buffer.
+-- @param client client socket
+-- @param buffer nixio buffer holding data already received from the client
+-- @return Request object
+function Server.read_request(self, client, buffer)
+	repeat
+		local method, uri, protocol, headers =
+			nixio.http_request(buffer, HEADERLIMIT)
+		if method then
+			return mkrequest(method, uri, protocol, headers)
+		elseif method == nil then
+			return nil, uri
+		end
+
+		local stat, code = client:readinto(buffer)
+		if not stat or stat == 0 then
+			return nil, code
+		end
+	until false
+end
+
 --- Parse the request headers and prepare the environment.
 -- @param source line-based input source
 -- @return Request object
@@ -407,9 +486,16 @@ end
 -- @param env superserver environment
 function Server.process(self, client, env)
 	local sourcein  = function() end
-	local sourcehdr = client:linesource()
+	local sourcehdr, hbuffer
 	local sinkout
 	local buffer
+
+	-- plain sockets are parsed from a buffer object, TLS line by line
+	if nixio.http_request and client:is_socket() then
+		hbuffer = nixio.buffer()
+	else
+		sourcehdr = client:linesource()
+	end
 	
 	local close = false
 	local stat, code, msg, message, err
@@ -424,7 +510,11 @@ function Server.process(self, client, env)
 	
 	repeat
 		-- parse headers
-		message, err = self:parse_headers(sourcehdr)
+		if hbuffer then
+			message, err = self:read_request(client, hbuffer)
+		else
+			message, err = self:parse_headers(sourcehdr)
+		end
 
 		-- any other error
 		if not message or err then
@@ -436,7 +526,7 @@ function Server.process(self, client, env)
 		end
 
 		-- Prepare sources and sinks
-		buffer = sourcehdr(true)
+		buffer = not hbuffer and sourcehdr(true)
 		sinkout = client:sink()
 		message.server = env
 		
@@ -475,6 +565,10 @@ function Server.process(self, client, env)
 				client:writeall("HTTP/1.1 100 Continue\r\n\r\n")
 			end
 			
+			if hbuffer then
+				buffer = hbuffer:read()
+			end
+
 			if message.headers['Transfer-Encoding'] and
 			 message.headers['Transfer-Encoding'] ~= "identity" then
 				sourcein = chunksource(client, buffer)
@@ -561,12 +655,14 @@ function Server.process(self, client, env)
 		if sourceout and stat then
 			local closefd
 			if util.instanceof(sourceout, IOResource) then
+				closefd = not sourceout.persistent and sourceout.fd
 				if not headers["Transfer-Encoding"] then
-					stat, code, msg = sourceout.fd:copyz(client, sourceout.len)
-					closefd = sourceout.fd
+					stat, code, msg = sourceout:send(client)
 					sourceout = nil
 				else
-					closefd = sourceout.fd
+					if sourceout.offset then
+						sourceout.fd:seek(sourceout.offset)
+					end
 					sourceout = sourceout.fd:blocksource(nil, sourceout.len)
 				end
 			end
@@ -590,7 +686,7 @@ function Server.process(self, client, env)
 			break
 		end
 		
-		if buffer then
+		if buffer and not hbuffer then
 			sourcehdr(buffer)
 		end
 	until close
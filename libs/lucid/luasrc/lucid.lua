@@ -26,6 +26,7 @@ module "luci.lucid"
 
 local slaves = {}
 local pollt  = {}
+local poller
 local tickt  = {}
 local tpids  = {}
 local tcount = 0
@@ -120,13 +121,21 @@ function run()
 	local pollint = tonumber((cursor:get(UCINAME, "main", "pollinterval")))
 	local threadlimit = tonumber((cursor:get(UCINAME, "main", "threadlimit")))
 
+	poller = poller or nixio.epoll()
+
 	while true do
-		local stat, code = nixio.poll(pollt, pollint)
+		for _, cb in ipairs(tickt) do
+			cb()
+		end
+		
+		local stat, ready = poller:wait(pollint)
 		
 		if stat and stat > 0 then
 			local ok = false
-			for _, polle in ipairs(pollt) do
-				if polle.revents ~= 0 and polle.handler then
+			for i = 1, 2 * stat, 2 do
+				local polle = ready[i]
+				polle.revents = ready[i+1]
+				if polle.handler then
 					ok = ok or polle.handler(polle)
 				end
 			end
@@ -138,10 +147,6 @@ function run()
 			ifaddrs = nixio.getifaddrs()
 		end
 		
-		for _, cb in ipairs(tickt) do
-			cb()
-		end
-		
 		local pid, stat, code = nixio.wait(-1, "nohang")
 		while pid and pid > 0 do
 			nixio.syslog("info", "Buried thread: " .. pid)
@@ -163,6 +168,10 @@ end
 -- @see unregister_pollfd
 -- @return boolean status
 function register_pollfd(polle)
+	poller = poller or nixio.epoll()
+	if not poller:add(polle.fd, polle.events, polle) then
+		return false
+	end
 	pollt[#pollt+1] = polle
 	return true 
 end
@@ -175,6 +184,7 @@ function unregister_pollfd(polle)
 	for k, v in ipairs(pollt) do
 		if v == polle then
 			table.remove(pollt, k)
+			poller:remove(polle.fd)
 			return true
 		end
 	end
@@ -189,6 +199,10 @@ function close_pollfds()
 			v.fd:close()
 		end
 	end
+	if poller then
+		poller:close()
+		poller = nil
+	end
 end
 
 --- Register a tick function that will be called at each cycle of the main loop.
@@ -19,7 +19,7 @@ local lucid = require "luci.lucid"
 
 local ipairs, type, require, setmetatable = ipairs, type, require, setmetatable
 local pairs, print, tostring, unpack = pairs, print, tostring, unpack
-local pcall = pcall
+local pcall, tonumber = pcall, tonumber
 
 module "luci.lucid.tcpserver"
 
@@ -27,6 +27,7 @@ local cursor = lucid.cursor
 local UCINAME = lucid.UCINAME
 
 local tcpsockets = {}
+local pools = {}
 
 --- Prepare a daemon and allocate its resources. (superserver callback)
 -- @param config configuration table
@@ -91,6 +92,22 @@ function prepare_daemon(config, server)
 		return nil, -3, err
 	else
 		local pollin = nixio.poll_flags("in")
+		local workers = tonumber(config.workers)
+		if workers and workers > 0 then
+			local pool = {
+				sockets = sockets,
+				size = workers,
+				count = 0,
+				maxconnections = tonumber(config.maxconnections),
+				accept = handler,
+				config = config,
+				publisher = publisher,
+				tls = tls
+			}
+			pools[#pools+1] = pool
+			server.register_tick(function() spawn_workers(pool) end)
+			return true
+		end
 		for _, s in ipairs(sockets) do
 			server.register_pollfd({
 				fd = s,
@@ -123,18 +140,7 @@ function accept(polle)
 	
 	local function thread()
 		lucid.close_pollfds()
-		local inst = setmetatable({
-			host = host, port = port, interfaces = lucid.get_interfaces() 
-		}, {__index = polle})
-		if polle.config.encryption then
-			socket = polle.tls:create(socket)
-			if not socket:accept() then
-				socket:close()
-				return nixio.syslog("warning", "TLS handshake failed: " .. host)
-			end
-		end
-		
-		return polle.accept(socket, inst)
+		return serve(polle, socket, host, port)
 	end
 	
 	local stat = {lucid.create_process(thread)}
@@ -142,6 +148,120 @@ function accept(polle)
 	return unpack(stat)
 end
 
+--- Handle an accepted TCP connection in the current process.
+-- @param polle Poll descriptor or worker pool
+-- @param socket client socket
+-- @param host client address
+-- @param port client port
+-- @return return value of the daemon handler
+function serve(polle, socket, host, port)
+	local inst = setmetatable({
+		host = host, port = port, interfaces = lucid.get_interfaces() 
+	}, {__index = polle})
+	if polle.config.encryption then
+		socket = polle.tls:create(socket)
+		if not socket:accept() then
+			socket:close()
+			return nixio.syslog("warning", "TLS handshake failed: " .. host)
+		end
+	end
+	
+	return polle.accept(socket, inst)
+end
+
+--- Start missing worker processes of a pre-forked pool. (tick callback)
+-- Each worker holds the write end of a pipe whose read end is polled by the
+-- superprocess, so an exiting worker is replaced immediately.
+-- @param pool worker pool
+function spawn_workers(pool)
+	local pollin = nixio.poll_flags("in")
+	while pool.count < pool.size and lucid.try_process() do
+		local pipein, pipeout = nixio.pipe()
+		if not pipein then
+			return nixio.syslog("err", "Unable to create worker pipe")
+		end
+		
+		local pid = lucid.create_process(function()
+			pipein:close()
+			return worker(pool, pipeout)
+		end)
+		pipeout:close()
+		
+		if not pid or pid == 0 then
+			pipein:close()
+			return
+		end
+		
+		pool.count = pool.count + 1
+		lucid.register_pollfd({
+			fd = pipein,
+			events = pollin,
+			revents = 0,
+			handler = worker_exited,
+			pool = pool
+		})
+	end
+end
+
+--- Replace a worker process whose pipe was closed. (server callback)
+-- @param polle Poll descriptor
+-- @return true
+function worker_exited(polle)
+	lucid.unregister_pollfd(polle)
+	polle.fd:close()
+	polle.pool.count = polle.pool.count - 1
+	spawn_workers(polle.pool)
+	return true
+end
+
+--- Main function of a pre-forked worker process.
+-- The worker accepts connections on the shared listening sockets until it
+-- served the configured number of connections or the superprocess is gone.
+-- @param pool worker pool
+-- @param alive write end of the worker pipe
+function worker(pool, alive)
+	lucid.close_pollfds()
+	for _, p in ipairs(pools) do
+		if p ~= pool then
+			for _, s in ipairs(p.sockets) do
+				s:close()
+			end
+		end
+	end
+	
+	local parent = nixio.getppid()
+	local pollint = tonumber((cursor:get(UCINAME, "main", "pollinterval")))
+	local poller = nixio.epoll()
+	for _, s in ipairs(pool.sockets) do
+		poller:add(s, nixio.poll_flags("in"))
+	end
+	
+	local served = 0
+	while not pool.maxconnections or served < pool.maxconnections do
+		local stat, ready = poller:wait(pollint or 1000)
+		if nixio.getppid() ~= parent then
+			break
+		end
+		
+		-- other workers may win the race for a connection (EAGAIN)
+		for i = 1, 2 * (stat or 0), 2 do
+			local socket, host, port = ready[i]:accept()
+			if socket then
+				socket:setblocking(true)
+				served = served + 1
+				local stat, err = pcall(serve, pool, socket, host, port)
+				if not stat then
+					nixio.syslog("err", "Worker failed to serve " .. host ..
+						": " .. tostring(err))
+					socket:close()
+				end
+			end
+		end
+	end
+	
+	alive:close()
+end
+
 --- Prepare a TCP server socket.
 -- @param family protocol family ["inetany", "inet6", "inet"]
 -- @param host host
@@ -1,6 +1,22 @@
 --- Changes and improvements.
 module "CHANGELOG"
 
+--- Feature Release.
+-- <ul>
+-- <li>Added persistent event poller nixio.epoll() with poll() fallback.</li>
+-- <li>Added nixio.buffer() objects and readinto(), writefrom(), readv() and
+-- writev() to files and sockets.</li>
+-- <li>Raised the per-call read limit of files and sockets to 16 MiB and
+-- implemented nixio.fs.readfile() in C.</li>
+-- <li>Added sendfile_range() and inotify support.</li>
+-- <li>Added a chunked transfer encoder and an HTTP request parser.</li>
+-- <li>Added urlencode(), urldecode() and a multipart/form-data parser.</li>
+-- <li>Added memory-mapped module packs.</li>
+-- </ul>
+-- @class table
+-- @name 0.4
+-- @return !
+
 --- Service Release.
 -- <ul>
 -- <li>Added getifaddrs() function.</li>
@@ -0,0 +1,53 @@
+--- Growable Byte Buffer Object.
+-- Data is appended at the write cursor and consumed from the read cursor.
+-- @cstyle	instance
+module "nixio.Buffer"
+
+--- Append a string to the buffer.
+-- @class function
+-- @name Buffer.write
+-- @param data	String
+-- @return number of bytes appended
+
+--- Consume data from the buffer.
+-- @class function
+-- @name Buffer.read
+-- @param length	Amount of data to consume (optional, default: all)
+-- @return string
+
+--- Return data from the buffer without consuming it.
+-- @class function
+-- @name Buffer.peek
+-- @param length	Amount of data to return (optional, default: all)
+-- @return string
+
+--- Discard data from the buffer.
+-- @class function
+-- @name Buffer.skip
+-- @param length	Amount of data to discard
+-- @return number of bytes discarded
+
+--- Find a string in the buffered data.
+-- @class function
+-- @name Buffer.find
+-- @usage The search is plain, patterns are not supported.
+-- @param string	String to search for
+-- @param init		Position to start the search at (optional, default: 1)
+-- @return start and end position or nil
+
+--- Consume a line from the buffer.
+-- @class function
+-- @name Buffer.readline
+-- @usage Lines may be terminated by "\n" or "\r\n", the terminator is not
+-- part of the returned line.
+-- @return line or nil if the buffer does not contain a complete line
+
+--- Return the amount of buffered data. This is also available as # operator.
+-- @class function
+-- @name Buffer.len
+-- @return number of bytes
+
+--- Discard all buffered data.
+-- @class function
+-- @name Buffer.clear
+-- @return true
@@ -0,0 +1,29 @@
+--- HTTP/1.1 Chunked Transfer Encoder Object.
+-- Small writes are collected and sent as one chunk once the threshold is
+-- reached. Each chunk is sent with a single writev() call.
+-- @cstyle	instance
+module "nixio.ChunkedEncoder"
+
+--- Encode data as part of the chunked stream.
+-- @class function
+-- @name ChunkedEncoder.write
+-- @usage Data is sent immediately if the threshold is reached, otherwise it
+-- is kept until the next write(), flush() or finish().
+-- @param data	String
+-- @return number of bytes accepted
+
+--- Send the pending data as a chunk.
+-- @class function
+-- @name ChunkedEncoder.flush
+-- @return true
+
+--- Send the pending data followed by the last chunk.
+-- @class function
+-- @name ChunkedEncoder.finish
+-- @usage Further writes raise an error.
+-- @return true
+
+--- Return the amount of data waiting to be sent.
+-- @class function
+-- @name ChunkedEncoder.pending
+-- @return number of bytes
@@ -0,0 +1,63 @@
+--- Persistent Event Poller Object.
+-- Supports edge and level triggered as well as one-shot notification.
+-- @cstyle	instance
+module "nixio.Epoll"
+
+--- Register a descriptor.
+-- @class function
+-- @name Epoll.add
+-- @usage The value is referenced by the poller until the descriptor is
+-- removed. Remove descriptors before closing them.
+-- @usage Edge triggering is approximated by level triggering in the
+-- poll() fallback.
+-- @param fd		I/O Descriptor [Socket Object, File Object, descriptor number]
+-- @param events	Events to wait for (bitfield generated with poll_flags)
+-- @param value		Value to return when the descriptor is ready
+-- (optional, default: the descriptor)
+-- @param mode		Notification mode ["level", "edge", "oneshot",
+-- "edge oneshot"] (optional, default: "level")
+-- @see nixio.poll_flags
+-- @return true
+
+--- Change the events of a registered descriptor.
+-- This also rearms descriptors registered in one-shot mode.
+-- @class function
+-- @name Epoll.modify
+-- @param fd		I/O Descriptor
+-- @param events	Events to wait for (bitfield generated with poll_flags)
+-- @param value		New value to return (optional, default: unchanged)
+-- @param mode		Notification mode (optional, default: "level")
+-- @return true
+
+--- Unregister a descriptor.
+-- @class function
+-- @name Epoll.remove
+-- @param fd		I/O Descriptor
+-- @return true
+
+--- Wait for events on the registered descriptors.
+-- @class function
+-- @name Epoll.wait
+-- @usage The returned table is reused by subsequent calls. It contains the
+-- value of the i-th ready descriptor at index 2i-1 and its revents-bitfield
+-- at index 2i.
+-- @usage This function is not signal-protected and may fail with EINTR.
+-- @param timeout	Timeout in milliseconds, -1 waits infinitely
+-- (optional, default: 0)
+-- @return number of ready IO descriptors, 0 on timeout
+-- @return table of values and revents-fields
+
+--- Return the event notification backend in use.
+-- @class function
+-- @name Epoll.backend
+-- @return "epoll" or "poll"
+
+--- Get the underlying epoll descriptor.
+-- @class function
+-- @name Epoll.fileno
+-- @return descriptor number, -1 for the poll() fallback
+
+--- Close the poller.
+-- @class function
+-- @name Epoll.close
+-- @return true
@@ -0,0 +1,22 @@
+--- Memory-mapped Module Pack Object.
+-- @cstyle	instance
+module "nixio.ModulePack"
+
+--- Load a chunk from the pack.
+-- The chunk is loaded directly from the mapped file.
+-- @class function
+-- @name ModulePack.load
+-- @param name	Name of the chunk
+-- @return Function<br />
+-- nothing if the pack does not contain the name<br />
+-- nil and an error message if the chunk is invalid
+
+--- Get the names of all chunks in the pack.
+-- @class function
+-- @name ModulePack.names
+-- @return Table of names in index order
+
+--- Unmap the pack.
+-- @class function
+-- @name ModulePack.close
+-- @return true
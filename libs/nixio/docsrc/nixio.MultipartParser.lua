@@ -0,0 +1,17 @@
+--- Streaming multipart/form-data Parser Object.
+-- @cstyle	instance
+module "nixio.MultipartParser"
+
+--- Feed data to the parser.
+-- The callback is invoked with the arguments (event, data, eof) for each
+-- part: once with event "header" and the raw header block of the part
+-- (every header line including its CRLF) and then one or more times with
+-- event "data" and the content of the part, eof is true for its last piece.
+-- @class function
+-- @name MultipartParser.parse
+-- @usage Data following the closing boundary is ignored.
+-- @usage The callback has to return true to continue, otherwise parse()
+-- returns nil and the second return value of the callback.
+-- @param chunk		String (nil at the end of the message)
+-- @param callback	Callback function
+-- @return true
@@ -98,7 +98,7 @@ module "nixio.Socket"
 -- You have to check the return value - the length of the buffer actually read -
 -- or use the safe IO functions in the high-level IO utility module.
 -- @usage The length of the return buffer is limited by the (compile time) 
--- nixio buffersize which is <em>nixio.const.buffersize</em> (8192 by default).
+-- nixio read limit which is <em>nixio.const.readmax</em> (16 MiB by default).
 -- Any read request greater than that will be safely truncated to this value.  
 -- @param length	Amount of data to read (in Bytes).
 -- @return buffer containing data successfully read
@@ -122,6 +122,41 @@ module "nixio.Socket"
 -- @see Socket.recvfrom
 -- @return buffer containing data successfully read
 
+--- Read from the descriptor into a buffer object.
+-- @class function
+-- @name Socket.readinto
+-- @usage The data is appended to the buffer without creating a Lua string.
+-- @param buffer	Buffer Object
+-- @param length	Amount of data to read (in Bytes, optional,
+-- default: nixio.const.buffersize).
+-- @return number of bytes read, 0 on end of file
+
+--- Write the contents of a buffer object to the descriptor.
+-- @class function
+-- @name Socket.writefrom
+-- @usage The data actually written is removed from the buffer.
+-- @param buffer	Buffer Object
+-- @param length	Amount of data to write (optional, default: all)
+-- @return number of bytes written
+
+--- (POSIX) Read from the descriptor into several buffer objects at once.
+-- @class function
+-- @name Socket.readv
+-- @usage The data is spread over the buffers in order, each receiving at most
+-- the given length.
+-- @param buffer1	Buffer Object
+-- @param length1	Amount of data to read into buffer1
+-- @param ...		More buffer and length pairs (up to 64 buffers)
+-- @return number of bytes read
+
+--- (POSIX) Write several strings or buffer objects at once.
+-- @class function
+-- @name Socket.writev
+-- @usage The data actually written is removed from given buffer objects.
+-- @param chunk1	String or Buffer Object
+-- @param ...		More chunks (up to 64)
+-- @return number of bytes written
+
 --- Close the socket.
 -- @class function
 -- @name Socket.close
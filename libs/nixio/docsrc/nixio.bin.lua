@@ -30,4 +30,19 @@ module "nixio.bin"
 -- @class function
 -- @name b64decode
 -- @param buffer	Base 64 Encoded data
--- @return binary data
\ No newline at end of file
+-- @return binary data
+
+--- Encode a string to x-www-urlencoded format.
+-- @class function
+-- @name urlencode
+-- @usage All characters except [a-zA-Z0-9$_-.+!*'(),] are encoded.
+-- @param buffer	Buffer
+-- @return urlencoded buffer
+
+--- Decode an x-www-urlencoded string.
+-- @class function
+-- @name urldecode
+-- @usage Invalid escape sequences are left untouched.
+-- @param buffer	Buffer
+-- @param no_plus	Do not decode "+" to " " (optional)
+-- @return decoded buffer
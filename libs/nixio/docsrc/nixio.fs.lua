@@ -178,6 +178,41 @@ module "nixio.fs"
 -- @return	path iterator
 -- @return	number of matches
 
+--- (Linux) Create an inotify instance.
+-- @class function
+-- @name nixio.fs.inotify
+-- @usage The returned descriptor is non-blocking and can be polled.
+-- @return	File Object
+
+--- (Linux) Watch a file or directory for changes.
+-- @class function
+-- @name nixio.fs.inotify_add
+-- @param	inotify	inotify File Object
+-- @param	path	Path
+-- @param	...		Events to watch ["access", "modify", "attrib", "close_write",
+-- "close_nowrite", "open", "moved_from", "moved_to", "create", "delete",
+-- "delete_self", "move_self"] (default: all)
+-- @return	watch descriptor
+
+--- (Linux) Stop watching a file or directory.
+-- @class function
+-- @name nixio.fs.inotify_rm
+-- @param	inotify	inotify File Object
+-- @param	wd		watch descriptor
+-- @return	true
+
+--- (Linux) Read pending events from an inotify instance.
+-- @class function
+-- @name nixio.fs.inotify_read
+-- @usage Fails with EAGAIN if no events are pending.
+-- @param	inotify	inotify File Object
+-- @return	Table of events containing: <ul>
+-- <li>wd = watch descriptor</li>
+-- <li>name = file name inside a watched directory (if applicable)</li>
+-- <li>one true field for each event flag, e.g. modify = true, including
+-- "unmount", "overflow" and "ignored"</li>
+-- </ul>
+
 --- (POSIX) Get filesystem statistics.
 -- @class function
 -- @name nixio.fs.statvfs
@@ -198,6 +233,7 @@ module "nixio.fs"
 --- Read the contents of a file into a buffer.
 -- @class function
 -- @name nixio.fs.readfile
+-- @usage Regular files are read with a single read call.
 -- @param	path Path
 -- @param	limit	Maximum bytes to read (optional)
 -- @return	file contents
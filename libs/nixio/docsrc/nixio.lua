@@ -189,6 +189,67 @@ module "nixio"
 -- @return number of ready IO descriptors
 -- @return the fds-table with revents-fields set
 
+--- Create a growable byte buffer.
+-- Buffers accumulate data read from descriptors without creating intermediate
+-- Lua strings, see File.readinto() and Socket.readinto().
+-- @class function
+-- @name nixio.buffer
+-- @param size	Initial capacity in bytes (optional)
+-- @return Buffer Object
+
+--- (POSIX) Create an HTTP/1.1 chunked transfer encoder writing to a descriptor.
+-- @class function
+-- @name nixio.chunked
+-- @usage The descriptor has to be blocking, an error during write() leaves
+-- the chunked stream in an undefined state.
+-- @param fd	File or Socket Object
+-- @param threshold	Coalesce writes until this many bytes are pending
+-- (optional, default: nixio.const.buffersize, 0 disables coalescing)
+-- @return ChunkedEncoder Object
+
+--- Parse an HTTP request head from a buffer object.
+-- The request line and headers are consumed from the buffer once they are
+-- complete, any following data (a request body or pipelined requests)
+-- remains in the buffer.
+-- @class function
+-- @name nixio.http_request
+-- @usage Header names are case-sensitive as sent by the client, if a header
+-- is repeated the last value is returned.
+-- @param buffer	Buffer Object
+-- @param limit	Maximum size of the request head
+-- (optional, default: nixio.const.buffersize)
+-- @return request method, request URI, protocol and a table of headers<br />
+-- false if the request head is incomplete<br />
+-- nil and an error message if the request is malformed or exceeds the limit
+
+--- Create a streaming parser for multipart/form-data message bodies.
+-- @class function
+-- @name nixio.multipart
+-- @param boundary	MIME boundary as given in the Content-Type header
+-- @return MultipartParser Object
+
+--- (POSIX) Map a module pack into memory.
+-- A pack starts with the magic "LUCIPACK" and the number of entries followed
+-- by an index of (hash, name offset, name length, code offset, code length)
+-- tuples sorted by the crc32 hash of the name, all values are unsigned 32 bit
+-- little endian integers. The names and the precompiled Lua chunks follow.
+-- @class function
+-- @name nixio.openpack
+-- @param path	Path of the pack file
+-- @return ModulePack Object<br />
+-- nil and an error message if the file is not a valid pack
+
+--- Create a persistent event poller.
+-- Descriptors are registered once with an associated value which is returned
+-- by Epoll.wait() when the descriptor becomes ready.
+-- @class function
+-- @name nixio.epoll
+-- @usage The object uses epoll() on Linux and falls back to poll() on other
+-- systems or if no epoll instance could be created, see Epoll.backend().
+-- @param maxevents	Maximum number of events returned per call (optional,
+-- default: 64)
+-- @return Epoll Object
+
 --- (POSIX) Clone the current process.
 -- @class function
 -- @name nixio.fork
@@ -370,6 +431,21 @@ module "nixio"
 -- @param length Amount of data to send (in Bytes).
 -- @return bytes sent
 
+--- (POSIX) Send a range of a file to a socket in kernel-space.
+-- Unlike sendfile() the whole range is sent in a single call and the file
+-- offset is not changed.
+-- @class function
+-- @name nixio.sendfile_range
+-- @usage If the socket is not writable the function waits up to timeout
+-- milliseconds for it to drain and fails with EAGAIN afterwards.
+-- @param socket Socket Object
+-- @param file	 File Object
+-- @param offset File offset to start sending from
+-- @param length Amount of data to send (in Bytes).
+-- @param timeout Timeout in milliseconds (optional, default: infinite)
+-- @return bytes sent, less than length if the end of file was reached
+-- @return On failure: nil, error code, error message and bytes sent
+
 --- (Linux) Send data from / to a pipe in kernel-space.
 -- @class function
 -- @name nixio.splice
@@ -21,20 +21,6 @@ require "nixio.util"
 module ("nixio.fs", function(m) setmetatable(m, {__index = nixio.fs}) end)
 
 
-function readfile(path, limit)
-	local fd, code, msg = nixio.open(path, "r")
-	local data
-	if not fd then
-		return nil, code, msg
-	end
-	
-	data, code, msg = fd:readall(limit)
-	
-	fd:close()
-	return data, code, msg
-end
-
-
 function writefile(path, data)
 	local fd, code, msg, stat = nixio.open(path, "w")
 	if not fd then
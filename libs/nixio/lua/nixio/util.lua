@@ -21,6 +21,7 @@ module "nixio.util"
 
 local BUFFERSIZE = nixio.const.buffersize
 local ZIOBLKSIZE = 65536
+local READBLKMAX = 1048576
 local socket = nixio.meta_socket
 local tls_socket = nixio.meta_tls_socket
 local file = nixio.meta_file
@@ -60,10 +61,12 @@ function meta.readall(self, len)
 		return "", nil, nil, ""
 	end
 
-	local data, total = {block}, #block
+	local data, total, blocksize = {block}, #block, BUFFERSIZE
 
 	while not len or len > total do
-		block, code, msg = self:read(len and (len - total) or BUFFERSIZE)
+		-- grow the block size for long reads of unknown length
+		blocksize = blocksize < READBLKMAX and blocksize * 2 or blocksize
+		block, code, msg = self:read(len and (len - total) or blocksize)
 
 		if not block then
 			return nil, code, msg, table.concat(data)
@@ -18,6 +18,7 @@
 
 #include "nixio.h"
 #include <stdlib.h>
+#include <string.h>
 
 const char nixio__bin2hex[16] = {
 '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f'
@@ -94,17 +95,20 @@ static const uint32_t nixio__crc32_tbl[] = {
 	0x2d02ef8dU
 };
 
-static int nixio_bin_crc32(lua_State *L) {
-	size_t len;
-	const char *buffer = luaL_checklstring(L, 1, &len);
-	uint32_t value = luaL_optinteger(L, 2, 0);
-
+uint32_t nixio__crc32(const char *buffer, size_t len, uint32_t value) {
 	value = ~value;
 	for (size_t i=0; i<len; i++) {
 		value = nixio__crc32_tbl[(value ^ buffer[i]) & 0xffU ] ^ (value >> 8);
 	}
+	return value ^ 0xffffffffU;
+}
+
+static int nixio_bin_crc32(lua_State *L) {
+	size_t len;
+	const char *buffer = luaL_checklstring(L, 1, &len);
+	uint32_t value = luaL_optinteger(L, 2, 0);
 
-	lua_pushinteger(L, (int)(value ^ 0xffffffffU));
+	lua_pushinteger(L, (int)nixio__crc32(buffer, len, value));
 	return 1;
 }
 
@@ -295,6 +299,94 @@ static int nixio_bin_b64decode(lua_State *L) {
 	return 1;
 }
 
+static int nixio_bin__hexval(char c) {
+	if (c >= '0' && c <= '9') {
+		return c - '0';
+	} else if (c >= 'a' && c <= 'f') {
+		return c - 'a' + 10;
+	} else if (c >= 'A' && c <= 'F') {
+		return c - 'A' + 10;
+	}
+	return -1;
+}
+
+static int nixio_bin_urldecode(lua_State *L) {
+	size_t len, i, o = 0;
+	const char *data = luaL_checklstring(L, 1, &len);
+	int plus = !lua_toboolean(L, 2);
+	int hi, lo;
+
+	if (!memchr(data, '%', len) && !(plus && memchr(data, '+', len))) {
+		lua_pushvalue(L, 1);
+		return 1;
+	}
+
+	char *out = malloc(len);
+	if (!out) {
+		return luaL_error(L, NIXIO_OOM);
+	}
+
+	for (i = 0; i < len; i++) {
+		if (data[i] == '%' && i + 2 < len
+		&& (hi = nixio_bin__hexval(data[i+1])) >= 0
+		&& (lo = nixio_bin__hexval(data[i+2])) >= 0) {
+			out[o++] = (hi << 4) | lo;
+			i += 2;
+		} else if (data[i] == '+' && plus) {
+			out[o++] = ' ';
+		} else {
+			out[o++] = data[i];
+		}
+	}
+
+	lua_pushlstring(L, out, o);
+	free(out);
+
+	return 1;
+}
+
+static int nixio_bin_urlencode(lua_State *L) {
+	size_t len, lenout, i, o = 0;
+	const unsigned char *data =
+		(const unsigned char*)luaL_checklstring(L, 1, &len);
+
+	/* characters passed through unencoded */
+	static const char safe[] = "$_-.+!*'(),";
+#define NIXIO_URLSAFE(c) (((c) >= 'a' && (c) <= 'z') || ((c) >= 'A' && (c) <= 'Z') \
+	|| ((c) >= '0' && (c) <= '9') || ((c) && strchr(safe, (c))))
+
+	for (i = 0; i < len && NIXIO_URLSAFE(data[i]); i++);
+	if (i == len) {
+		lua_pushvalue(L, 1);
+		return 1;
+	}
+
+	lenout = len * 3;
+	luaL_argcheck(L, lenout > len, 1, "size overflow");
+
+	char *out = malloc(lenout);
+	if (!out) {
+		return luaL_error(L, NIXIO_OOM);
+	}
+
+	memcpy(out, data, i);
+	for (o = i; i < len; i++) {
+		if (NIXIO_URLSAFE(data[i])) {
+			out[o++] = data[i];
+		} else {
+			out[o++] = '%';
+			out[o++] = nixio__bin2hex[(data[i] & 0xf0) >> 4];
+			out[o++] = nixio__bin2hex[(data[i] & 0x0f)];
+		}
+	}
+#undef NIXIO_URLSAFE
+
+	lua_pushlstring(L, out, o);
+	free(out);
+
+	return 1;
+}
+
 /* module table */
 static const luaL_reg R[] = {
 	{"hexlify",		nixio_bin_hexlify},
@@ -302,6 +394,8 @@ static const luaL_reg R[] = {
 	{"crc32",		nixio_bin_crc32},
 	{"b64encode",	nixio_bin_b64encode},
 	{"b64decode",	nixio_bin_b64decode},
+	{"urlencode",	nixio_bin_urlencode},
+	{"urldecode",	nixio_bin_urldecode},
 	{NULL,			NULL}
 };
 
@@ -0,0 +1,477 @@
+/*
+ * nixio - Linux I/O library for lua
+ *
+ *   Copyright (C) 2009 Steven Barth <steven@midlink.org>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "nixio.h"
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <unistd.h>
+
+#ifndef __WINNT__
+#include <sys/uio.h>
+#endif
+
+/* maximum number of chunks per readv() / writev() call */
+#define NIXIO_IOV_MAX 64
+
+
+nixio_buf* nixio__checkbuffer(lua_State *L, int idx) {
+	return luaL_checkudata(L, idx, NIXIO_BUFFER_META);
+}
+
+/**
+ * Make room for len more bytes behind the write cursor
+ */
+int nixio__buffer_reserve(nixio_buf *buf, size_t len) {
+	size_t used = buf->wpos - buf->rpos;
+
+	if (buf->size - buf->wpos >= len) {
+		return 0;
+	}
+
+	/* move the unread data to the front first */
+	if (buf->rpos) {
+		memmove(buf->data, buf->data + buf->rpos, used);
+		buf->rpos = 0;
+		buf->wpos = used;
+		if (buf->size - used >= len) {
+			return 0;
+		}
+	}
+
+	size_t size = (buf->size > 0) ? buf->size * 2 : NIXIO_BUFFERSIZE;
+	if (size < used + len) {
+		size = used + len;
+	}
+
+	char *data = realloc(buf->data, size);
+	if (!data) {
+		return -1;
+	}
+
+	buf->data = data;
+	buf->size = size;
+	return 0;
+}
+
+/**
+ * Advance the read cursor, rewinding both cursors once all data is consumed
+ */
+void nixio__buffer_consume(nixio_buf *buf, size_t len) {
+	buf->rpos += len;
+	if (buf->rpos >= buf->wpos) {
+		buf->rpos = buf->wpos = 0;
+	}
+}
+
+/* locate a string in the unread data */
+static const char* nixio_buffer__find(nixio_buf *buf, size_t init,
+const char *str, size_t len) {
+	const char *pos = buf->data + buf->rpos + init;
+	const char *end = buf->data + buf->wpos;
+
+	while (end - pos >= (ptrdiff_t)len) {
+		pos = memchr(pos, str[0], end - pos - len + 1);
+		if (!pos) {
+			break;
+		} else if (!memcmp(pos, str, len)) {
+			return pos;
+		}
+		pos++;
+	}
+
+	return NULL;
+}
+
+static int nixio_fd__issock(lua_State *L, int idx) {
+	int sock = 0;
+	if (lua_getmetatable(L, idx)) {
+		luaL_getmetatable(L, NIXIO_META);
+		sock = lua_rawequal(L, -1, -2);
+		lua_pop(L, 2);
+	}
+	return sock;
+}
+
+/**
+ * buffer([size])
+ */
+static int nixio_buffer(lua_State *L) {
+	size_t size = luaL_optint(L, 1, 0);
+	nixio_buf *buf = lua_newuserdata(L, sizeof(nixio_buf));
+	memset(buf, 0, sizeof(nixio_buf));
+
+	luaL_getmetatable(L, NIXIO_BUFFER_META);
+	lua_setmetatable(L, -2);
+
+	if (size > 0 && nixio__buffer_reserve(buf, size)) {
+		return luaL_error(L, NIXIO_OOM);
+	}
+
+	return 1;
+}
+
+/**
+ * buffer:write(data)
+ */
+static int nixio_buffer_write(lua_State *L) {
+	nixio_buf *buf = nixio__checkbuffer(L, 1);
+	size_t len;
+	const char *data = luaL_checklstring(L, 2, &len);
+
+	if (nixio__buffer_reserve(buf, len)) {
+		return luaL_error(L, NIXIO_OOM);
+	}
+
+	memcpy(buf->data + buf->wpos, data, len);
+	buf->wpos += len;
+
+	lua_pushinteger(L, len);
+	return 1;
+}
+
+static int nixio_buffer__read(lua_State *L, int consume) {
+	nixio_buf *buf = nixio__checkbuffer(L, 1);
+	size_t len = buf->wpos - buf->rpos;
+	size_t req = luaL_optint(L, 2, len);
+
+	if (req < len) {
+		len = req;
+	}
+
+	lua_pushlstring(L, buf->data + buf->rpos, len);
+	if (consume) {
+		nixio__buffer_consume(buf, len);
+	}
+	return 1;
+}
+
+/**
+ * buffer:read([length])
+ */
+static int nixio_buffer_read(lua_State *L) {
+	return nixio_buffer__read(L, 1);
+}
+
+/**
+ * buffer:peek([length])
+ */
+static int nixio_buffer_peek(lua_State *L) {
+	return nixio_buffer__read(L, 0);
+}
+
+/**
+ * buffer:skip(length)
+ */
+static int nixio_buffer_skip(lua_State *L) {
+	nixio_buf *buf = nixio__checkbuffer(L, 1);
+	size_t len = buf->wpos - buf->rpos;
+	size_t req = luaL_checkinteger(L, 2);
+
+	if (req < len) {
+		len = req;
+	}
+
+	nixio__buffer_consume(buf, len);
+	lua_pushinteger(L, len);
+	return 1;
+}
+
+/**
+ * buffer:find(string, [init])
+ */
+static int nixio_buffer_find(lua_State *L) {
+	nixio_buf *buf = nixio__checkbuffer(L, 1);
+	size_t len;
+	const char *str = luaL_checklstring(L, 2, &len);
+	size_t init = luaL_optint(L, 3, 1);
+
+	if (init < 1 || init - 1 > buf->wpos - buf->rpos) {
+		lua_pushnil(L);
+		return 1;
+	}
+
+	if (!len) {
+		lua_pushinteger(L, init);
+		lua_pushinteger(L, init - 1);
+		return 2;
+	}
+
+	const char *pos = nixio_buffer__find(buf, init - 1, str, len);
+	if (!pos) {
+		lua_pushnil(L);
+		return 1;
+	}
+
+	lua_pushinteger(L, pos - (buf->data + buf->rpos) + 1);
+	lua_pushinteger(L, pos - (buf->data + buf->rpos) + len);
+	return 2;
+}
+
+/**
+ * buffer:readline()
+ */
+static int nixio_buffer_readline(lua_State *L) {
+	nixio_buf *buf = nixio__checkbuffer(L, 1);
+	const char *start = buf->data + buf->rpos;
+	const char *eol = nixio_buffer__find(buf, 0, "\n", 1);
+
+	if (!eol) {
+		lua_pushnil(L);
+		return 1;
+	}
+
+	size_t len = eol - start;
+	lua_pushlstring(L, start, (len && eol[-1] == '\r') ? len - 1 : len);
+	nixio__buffer_consume(buf, len + 1);
+	return 1;
+}
+
+static int nixio_buffer_len(lua_State *L) {
+	nixio_buf *buf = nixio__checkbuffer(L, 1);
+	lua_pushinteger(L, buf->wpos - buf->rpos);
+	return 1;
+}
+
+static int nixio_buffer_clear(lua_State *L) {
+	nixio_buf *buf = nixio__checkbuffer(L, 1);
+	buf->rpos = buf->wpos = 0;
+	lua_pushboolean(L, 1);
+	return 1;
+}
+
+static int nixio_buffer__gc(lua_State *L) {
+	nixio_buf *buf = luaL_checkudata(L, 1, NIXIO_BUFFER_META);
+	free(buf->data);
+	memset(buf, 0, sizeof(nixio_buf));
+	return 0;
+}
+
+static int nixio_buffer__tostring(lua_State *L) {
+	nixio_buf *buf = nixio__checkbuffer(L, 1);
+	lua_pushfstring(L, "nixio buffer %d", (int)(buf->wpos - buf->rpos));
+	return 1;
+}
+
+/**
+ * fd:readinto(buffer, [length])
+ */
+static int nixio_fd_readinto(lua_State *L) {
+	int fd = nixio__checkfd(L, 1);
+	int sock = nixio_fd__issock(L, 1);
+	nixio_buf *buf = nixio__checkbuffer(L, 2);
+	int req = luaL_optint(L, 3, NIXIO_BUFFERSIZE);
+	ssize_t readc;
+
+	luaL_argcheck(L, req >= 0, 3, "invalid length");
+
+	if (nixio__buffer_reserve(buf, req)) {
+		return luaL_error(L, NIXIO_OOM);
+	}
+
+	do {
+		readc = sock ? recv(fd, buf->data + buf->wpos, req, 0)
+			: read(fd, buf->data + buf->wpos, req);
+	} while (readc == -1 && errno == EINTR);
+
+	if (readc < 0) {
+		return (sock) ? nixio__perror_s(L) : nixio__perror(L);
+	}
+
+	buf->wpos += readc;
+	lua_pushinteger(L, readc);
+	return 1;
+}
+
+/**
+ * fd:writefrom(buffer, [length])
+ */
+static int nixio_fd_writefrom(lua_State *L) {
+	int fd = nixio__checkfd(L, 1);
+	int sock = nixio_fd__issock(L, 1);
+	nixio_buf *buf = nixio__checkbuffer(L, 2);
+	size_t len = buf->wpos - buf->rpos;
+	size_t req = luaL_optint(L, 3, len);
+	ssize_t sent;
+
+	if (req < len) {
+		len = req;
+	}
+
+	do {
+		sent = sock ? send(fd, buf->data + buf->rpos, len, 0)
+			: write(fd, buf->data + buf->rpos, len);
+	} while (sent == -1 && errno == EINTR);
+
+	if (sent < 0) {
+		return (sock) ? nixio__perror_s(L) : nixio__perror(L);
+	}
+
+	nixio__buffer_consume(buf, sent);
+	lua_pushinteger(L, sent);
+	return 1;
+}
+
+#ifndef __WINNT__
+
+/**
+ * fd:readv(buffer1, length1, buffer2, length2, ...)
+ */
+static int nixio_fd_readv(lua_State *L) {
+	int fd = nixio__checkfd(L, 1);
+	int n = (lua_gettop(L) - 1) / 2;
+	struct iovec iov[NIXIO_IOV_MAX];
+	nixio_buf *bufs[NIXIO_IOV_MAX];
+	ssize_t readc;
+	int i, j, req;
+
+	luaL_argcheck(L, n > 0 && n <= NIXIO_IOV_MAX, 2, "invalid number of buffers");
+
+	for (i = 0; i < n; i++) {
+		bufs[i] = nixio__checkbuffer(L, 2 * i + 2);
+		req = luaL_checkinteger(L, 2 * i + 3);
+		luaL_argcheck(L, req >= 0, 2 * i + 3, "invalid length");
+
+		/* a second reserve could move the data of an earlier chunk */
+		for (j = 0; j < i; j++) {
+			luaL_argcheck(L, bufs[j] != bufs[i], 2 * i + 2, "buffer given twice");
+		}
+
+		iov[i].iov_len = req;
+		if (nixio__buffer_reserve(bufs[i], iov[i].iov_len)) {
+			return luaL_error(L, NIXIO_OOM);
+		}
+		iov[i].iov_base = bufs[i]->data + bufs[i]->wpos;
+	}
+
+	do {
+		readc = readv(fd, iov, n);
+	} while (readc == -1 && errno == EINTR);
+
+	if (readc < 0) {
+		return nixio__perror(L);
+	}
+
+	/* the data is spread over the buffers in order */
+	lua_pushinteger(L, readc);
+	for (i = 0; i < n && readc > 0; i++) {
+		size_t len = ((size_t)readc < iov[i].iov_len) ? readc : iov[i].iov_len;
+		bufs[i]->wpos += len;
+		readc -= len;
+	}
+
+	return 1;
+}
+
+/**
+ * fd:writev(data1, data2, ...)
+ */
+static int nixio_fd_writev(lua_State *L) {
+	int fd = nixio__checkfd(L, 1);
+	int n = lua_gettop(L) - 1;
+	struct iovec iov[NIXIO_IOV_MAX];
+	ssize_t sent;
+	int i;
+
+	luaL_argcheck(L, n > 0 && n <= NIXIO_IOV_MAX, 2, "invalid number of chunks");
+
+	for (i = 0; i < n; i++) {
+		if (lua_type(L, i + 2) == LUA_TSTRING) {
+			iov[i].iov_base = (char *)lua_tolstring(L, i + 2, &iov[i].iov_len);
+		} else {
+			nixio_buf *buf = nixio__checkbuffer(L, i + 2);
+			iov[i].iov_base = buf->data + buf->rpos;
+			iov[i].iov_len = buf->wpos - buf->rpos;
+		}
+	}
+
+	do {
+		sent = writev(fd, iov, n);
+	} while (sent == -1 && errno == EINTR);
+
+	if (sent < 0) {
+		return nixio__perror(L);
+	}
+
+	/* consume what was written from the buffers */
+	lua_pushinteger(L, sent);
+	for (i = 0; i < n && sent > 0; i++) {
+		size_t len = ((size_t)sent < iov[i].iov_len) ? sent : iov[i].iov_len;
+		if (lua_type(L, i + 2) != LUA_TSTRING) {
+			nixio__buffer_consume(lua_touserdata(L, i + 2), len);
+		}
+		sent -= len;
+	}
+
+	return 1;
+}
+
+#endif
+
+
+/* module table */
+static const luaL_reg R[] = {
+	{"buffer",		nixio_buffer},
+	{NULL,			NULL}
+};
+
+/* buffer object table */
+static const luaL_reg M[] = {
+	{"write",		nixio_buffer_write},
+	{"read",		nixio_buffer_read},
+	{"peek",		nixio_buffer_peek},
+	{"skip",		nixio_buffer_skip},
+	{"find",		nixio_buffer_find},
+	{"readline",	nixio_buffer_readline},
+	{"len",			nixio_buffer_len},
+	{"clear",		nixio_buffer_clear},
+	{"__len",		nixio_buffer_len},
+	{"__gc",		nixio_buffer__gc},
+	{"__tostring",	nixio_buffer__tostring},
+	{NULL,			NULL}
+};
+
+/* socket and file object table */
+static const luaL_reg F[] = {
+	{"readinto",	nixio_fd_readinto},
+	{"writefrom",	nixio_fd_writefrom},
+#ifndef __WINNT__
+	{"readv",		nixio_fd_readv},
+	{"writev",		nixio_fd_writev},
+#endif
+	{NULL,			NULL}
+};
+
+void nixio_open_buffer(lua_State *L) {
+	luaL_register(L, NULL, R);
+
+	luaL_newmetatable(L, NIXIO_BUFFER_META);
+	luaL_register(L, NULL, M);
+	lua_pushvalue(L, -1);
+	lua_setfield(L, -2, "__index");
+	lua_setfield(L, -2, "meta_buffer");
+
+	luaL_getmetatable(L, NIXIO_META);
+	luaL_register(L, NULL, F);
+	lua_pop(L, 1);
+
+	luaL_getmetatable(L, NIXIO_FILE_META);
+	luaL_register(L, NULL, F);
+	lua_pop(L, 1);
+}
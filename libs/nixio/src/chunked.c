@@ -0,0 +1,244 @@
+/*
+ * nixio - Linux I/O library for lua
+ *
+ *   Copyright (C) 2009 Steven Barth <steven@midlink.org>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "nixio.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#ifndef __WINNT__
+#include <sys/uio.h>
+
+/* HTTP/1.1 chunked transfer encoder, small writes are coalesced */
+typedef struct nixio_chunked {
+	int fd;
+	int finished;
+	size_t threshold;	/* flush once this much data is pending */
+	size_t len;			/* pending data */
+	char *data;
+} nixio_chunked_t;
+
+static nixio_chunked_t* nixio__checkchunked(lua_State *L) {
+	nixio_chunked_t *ch = luaL_checkudata(L, 1, NIXIO_CHUNKED_META);
+	luaL_argcheck(L, ch->fd != -1, 1, "invalid encoder object");
+	return ch;
+}
+
+/**
+ * Write the whole vector, resuming after partial writes
+ */
+static int nixio_chunked__writev(int fd, struct iovec *iov, int n) {
+	ssize_t sent;
+
+	while (n > 0) {
+		sent = writev(fd, iov, n);
+		if (sent < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return -1;
+		}
+
+		while (n > 0 && (size_t)sent >= iov->iov_len) {
+			sent -= iov->iov_len;
+			iov++;
+			n--;
+		}
+		if (n > 0) {
+			iov->iov_base = (char *)iov->iov_base + sent;
+			iov->iov_len -= sent;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Send the pending data followed by extra as a single chunk,
+ * optionally terminated by the last-chunk marker
+ */
+static int nixio_chunked__emit(nixio_chunked_t *ch, const char *extra,
+size_t extralen, int last) {
+	struct iovec iov[5];
+	char head[20];
+	size_t total = ch->len + extralen;
+	int n = 0;
+
+	if (total > 0) {
+		iov[n].iov_base = head;
+		iov[n++].iov_len = snprintf(head, sizeof(head), "%lX\r\n",
+				(unsigned long)total);
+		if (ch->len > 0) {
+			iov[n].iov_base = ch->data;
+			iov[n++].iov_len = ch->len;
+		}
+		if (extralen > 0) {
+			iov[n].iov_base = (char *)extra;
+			iov[n++].iov_len = extralen;
+		}
+		iov[n].iov_base = "\r\n";
+		iov[n++].iov_len = 2;
+	}
+	if (last) {
+		iov[n].iov_base = "0\r\n\r\n";
+		iov[n++].iov_len = 5;
+	}
+
+	ch->len = 0;
+	return nixio_chunked__writev(ch->fd, iov, n);
+}
+
+/**
+ * nixio.chunked(fd, threshold)
+ */
+static int nixio_chunked(lua_State *L) {
+	int fd = nixio__checkfd(L, 1);
+	lua_Integer threshold = luaL_optinteger(L, 2, NIXIO_BUFFERSIZE);
+	luaL_argcheck(L, threshold >= 0 && threshold <= NIXIO_READMAX, 2,
+			"invalid threshold");
+
+	nixio_chunked_t *ch = lua_newuserdata(L, sizeof(nixio_chunked_t));
+	ch->fd = -1;
+	ch->finished = 0;
+	ch->threshold = threshold;
+	ch->len = 0;
+	ch->data = NULL;
+
+	luaL_getmetatable(L, NIXIO_CHUNKED_META);
+	lua_setmetatable(L, -2);
+
+	if (threshold > 0 && !(ch->data = malloc(threshold))) {
+		return luaL_error(L, NIXIO_OOM);
+	}
+	ch->fd = fd;
+
+	/* keep the descriptor object alive */
+	lua_newtable(L);
+	lua_pushvalue(L, 1);
+	lua_rawseti(L, -2, 1);
+	lua_setfenv(L, -2);
+
+	return 1;
+}
+
+/**
+ * encoder:write(data)
+ */
+static int nixio_chunked_write(lua_State *L) {
+	nixio_chunked_t *ch = nixio__checkchunked(L);
+	size_t len;
+	const char *data = luaL_checklstring(L, 2, &len);
+
+	if (ch->finished) {
+		return luaL_error(L, "chunked stream already finished");
+	}
+
+	if (ch->len + len < ch->threshold) {
+		memcpy(ch->data + ch->len, data, len);
+		ch->len += len;
+	} else if (nixio_chunked__emit(ch, data, len, 0)) {
+		return nixio__perror(L);
+	}
+
+	lua_pushinteger(L, len);
+	return 1;
+}
+
+/**
+ * encoder:flush()
+ */
+static int nixio_chunked_flush(lua_State *L) {
+	nixio_chunked_t *ch = nixio__checkchunked(L);
+	if (ch->len > 0 && nixio_chunked__emit(ch, NULL, 0, 0)) {
+		return nixio__perror(L);
+	}
+	lua_pushboolean(L, 1);
+	return 1;
+}
+
+/**
+ * encoder:finish()
+ */
+static int nixio_chunked_finish(lua_State *L) {
+	nixio_chunked_t *ch = nixio__checkchunked(L);
+	if (!ch->finished) {
+		ch->finished = 1;
+		if (nixio_chunked__emit(ch, NULL, 0, 1)) {
+			return nixio__perror(L);
+		}
+	}
+	lua_pushboolean(L, 1);
+	return 1;
+}
+
+/**
+ * encoder:pending()
+ */
+static int nixio_chunked_pending(lua_State *L) {
+	lua_pushinteger(L, nixio__checkchunked(L)->len);
+	return 1;
+}
+
+static int nixio_chunked__gc(lua_State *L) {
+	nixio_chunked_t *ch = luaL_checkudata(L, 1, NIXIO_CHUNKED_META);
+	free(ch->data);
+	ch->data = NULL;
+	ch->fd = -1;
+	return 0;
+}
+
+static int nixio_chunked__tostring(lua_State *L) {
+	lua_pushfstring(L, "nixio chunked encoder %p", lua_touserdata(L, 1));
+	return 1;
+}
+
+
+/* module table */
+static const luaL_reg R[] = {
+	{"chunked",		nixio_chunked},
+	{NULL,			NULL}
+};
+
+/* encoder object table */
+static const luaL_reg M[] = {
+	{"write",		nixio_chunked_write},
+	{"flush",		nixio_chunked_flush},
+	{"finish",		nixio_chunked_finish},
+	{"pending",		nixio_chunked_pending},
+	{"__gc",		nixio_chunked__gc},
+	{"__tostring",	nixio_chunked__tostring},
+	{NULL,			NULL}
+};
+
+void nixio_open_chunked(lua_State *L) {
+	luaL_register(L, NULL, R);
+
+	luaL_newmetatable(L, NIXIO_CHUNKED_META);
+	luaL_register(L, NULL, M);
+	lua_pushvalue(L, -1);
+	lua_setfield(L, -2, "__index");
+	lua_setfield(L, -2, "meta_chunked");
+}
+
+#else /* __WINNT__ */
+
+void nixio_open_chunked(lua_State *L) {
+}
+
+#endif /* !__WINNT__ */
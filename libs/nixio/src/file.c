@@ -204,21 +204,33 @@ static int nixio_file_write(lua_State *L) {
 
 static int nixio_file_read(lua_State *L) {
 	int fd = nixio__checkfd(L, 1);
-	char buffer[NIXIO_BUFFERSIZE];
+	char stackbuf[NIXIO_BUFFERSIZE];
+	char *buffer = stackbuf;
 	uint req = luaL_checkinteger(L, 2);
 	int readc;
 
-	/* We limit the readsize to NIXIO_BUFFERSIZE */
-	req = (req > NIXIO_BUFFERSIZE) ? NIXIO_BUFFERSIZE : req;
+	/* Large reads go to the heap, limited to NIXIO_READMAX */
+	if (req > NIXIO_BUFFERSIZE) {
+		req = (req > NIXIO_READMAX) ? NIXIO_READMAX : req;
+		if (!(buffer = malloc(req))) {
+			return luaL_error(L, NIXIO_OOM);
+		}
+	}
 
 	do {
 		readc = read(fd, buffer, req);
 	} while (readc == -1 && errno == EINTR);
 
 	if (readc < 0) {
+		if (buffer != stackbuf) {
+			free(buffer);
+		}
 		return nixio__perror(L);
 	} else {
 		lua_pushlstring(L, buffer, readc);
+		if (buffer != stackbuf) {
+			free(buffer);
+		}
 		return 1;
 	}
 }
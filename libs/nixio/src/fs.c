@@ -20,6 +20,7 @@
 #include <libgen.h>
 #include <string.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <limits.h>
 #include <stdlib.h>
 #include <sys/stat.h>
@@ -27,6 +28,10 @@
 #include <sys/time.h>
 #include <dirent.h>
 
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
 /* Reads argument from given index and transforms it into a mode bitfield */
 int nixio__check_mode(lua_State *L, int idx, int def) {
 	if (lua_isnoneornil(L, idx) && def > 0) {
@@ -518,6 +523,219 @@ static int nixio_statvfs(lua_State *L) {
 
 
 
+/**
+ * readfile(path, [limit])
+ */
+static int nixio_readfile(lua_State *L) {
+	const char *path = luaL_checkstring(L, 1);
+	size_t limit = lua_isnoneornil(L, 2)
+		? (size_t)-1 : (size_t)nixio__checknumber(L, 2);
+	size_t total = 0;
+	ssize_t readc = 0;
+	nixio_stat_t buf;
+	luaL_Buffer b;
+	int fd;
+
+	do {
+		fd = open(path, O_RDONLY);
+	} while (fd == -1 && errno == EINTR);
+	if (fd == -1) {
+		return nixio__perror(L);
+	}
+
+	/* regular files are read at once, others in chunks until EOF */
+	if (!fstat(fd, &buf) && S_ISREG(buf.st_mode) && buf.st_size > 0) {
+		size_t size = ((size_t)buf.st_size < limit) ? buf.st_size : limit;
+		char *data = malloc(size);
+		if (!data) {
+			close(fd);
+			return luaL_error(L, NIXIO_OOM);
+		}
+
+		while (total < size) {
+			readc = read(fd, data + total, size - total);
+			if (readc == -1 && errno == EINTR) {
+				continue;
+			} else if (readc < 1) {
+				break;
+			}
+			total += readc;
+		}
+
+		if (readc < 0) {
+			free(data);
+			close(fd);
+			return nixio__perror(L);
+		}
+
+		close(fd);
+		lua_pushlstring(L, data, total);
+		free(data);
+		return 1;
+	}
+
+	luaL_buffinit(L, &b);
+	while (total < limit) {
+		size_t req = (limit - total < LUAL_BUFFERSIZE)
+			? limit - total : LUAL_BUFFERSIZE;
+		do {
+			readc = read(fd, luaL_prepbuffer(&b), req);
+		} while (readc == -1 && errno == EINTR);
+
+		if (readc < 0) {
+			close(fd);
+			return nixio__perror(L);
+		} else if (readc == 0) {
+			break;
+		}
+
+		luaL_addsize(&b, readc);
+		total += readc;
+	}
+
+	close(fd);
+	luaL_pushresult(&b);
+	return 1;
+}
+
+
+#ifdef __linux__
+
+static const struct {
+	const char *name;
+	uint32_t mask;
+} nixio_inotify_flags[] = {
+	{"access",			IN_ACCESS},
+	{"modify",			IN_MODIFY},
+	{"attrib",			IN_ATTRIB},
+	{"close_write",		IN_CLOSE_WRITE},
+	{"close_nowrite",	IN_CLOSE_NOWRITE},
+	{"open",			IN_OPEN},
+	{"moved_from",		IN_MOVED_FROM},
+	{"moved_to",		IN_MOVED_TO},
+	{"create",			IN_CREATE},
+	{"delete",			IN_DELETE},
+	{"delete_self",		IN_DELETE_SELF},
+	{"move_self",		IN_MOVE_SELF},
+	{"unmount",			IN_UNMOUNT},
+	{"overflow",		IN_Q_OVERFLOW},
+	{"ignored",			IN_IGNORED},
+	{NULL,				0}
+};
+
+/**
+ * inotify()
+ */
+static int nixio_inotify(lua_State *L) {
+	int fd = inotify_init();
+	if (fd == -1) {
+		return nixio__perror(L);
+	}
+
+	fcntl(fd, F_SETFD, fcntl(fd, F_GETFD) | FD_CLOEXEC);
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+	int *udata = lua_newuserdata(L, sizeof(int));
+	if (!udata) {
+		close(fd);
+		return luaL_error(L, NIXIO_OOM);
+	}
+
+	*udata = fd;
+
+	luaL_getmetatable(L, NIXIO_FILE_META);
+	lua_setmetatable(L, -2);
+
+	return 1;
+}
+
+/**
+ * inotify_add(inotify, path, flag1, ...)
+ */
+static int nixio_inotify_add(lua_State *L) {
+	int fd = nixio__checkfd(L, 1);
+	const char *path = luaL_checkstring(L, 2);
+	const int j = lua_gettop(L);
+	uint32_t mask = 0;
+
+	for (int i = 3; i <= j; i++) {
+		const char *flag = luaL_checkstring(L, i);
+		int k;
+		for (k = 0; nixio_inotify_flags[k].name; k++) {
+			if (!strcmp(flag, nixio_inotify_flags[k].name)) {
+				mask |= nixio_inotify_flags[k].mask;
+				break;
+			}
+		}
+		if (!nixio_inotify_flags[k].name) {
+			return luaL_argerror(L, i, "unsupported inotify flag");
+		}
+	}
+
+	int wd = inotify_add_watch(fd, path, mask ? mask : IN_ALL_EVENTS);
+	if (wd == -1) {
+		return nixio__perror(L);
+	}
+
+	lua_pushinteger(L, wd);
+	return 1;
+}
+
+/**
+ * inotify_rm(inotify, wd)
+ */
+static int nixio_inotify_rm(lua_State *L) {
+	int fd = nixio__checkfd(L, 1);
+	int wd = luaL_checkinteger(L, 2);
+	return nixio__pstatus(L, !inotify_rm_watch(fd, wd));
+}
+
+/**
+ * inotify_read(inotify)
+ */
+static int nixio_inotify_read(lua_State *L) {
+	int fd = nixio__checkfd(L, 1);
+	char buffer[NIXIO_BUFFERSIZE]
+		__attribute__ ((aligned(__alignof__(struct inotify_event))));
+	ssize_t readc;
+	int n = 0;
+
+	do {
+		readc = read(fd, buffer, sizeof(buffer));
+	} while (readc == -1 && errno == EINTR);
+
+	if (readc < 0) {
+		return nixio__perror(L);
+	}
+
+	lua_newtable(L);
+	for (char *ptr = buffer; ptr < buffer + readc; ) {
+		struct inotify_event *ev = (struct inotify_event *)ptr;
+
+		lua_createtable(L, 0, 3);
+		lua_pushinteger(L, ev->wd);
+		lua_setfield(L, -2, "wd");
+		if (ev->len > 0) {
+			lua_pushstring(L, ev->name);
+			lua_setfield(L, -2, "name");
+		}
+		for (int k = 0; nixio_inotify_flags[k].name; k++) {
+			if (ev->mask & nixio_inotify_flags[k].mask) {
+				lua_pushboolean(L, 1);
+				lua_setfield(L, -2, nixio_inotify_flags[k].name);
+			}
+		}
+		lua_rawseti(L, -2, ++n);
+
+		ptr += sizeof(struct inotify_event) + ev->len;
+	}
+
+	return 1;
+}
+
+#endif
+
+
 /* module table */
 static const luaL_reg R[] = {
 #ifndef __WINNT__
@@ -528,6 +746,12 @@ static const luaL_reg R[] = {
 	{"chown",		nixio_chown},
 	{"lchown",		nixio_lchown},
 	{"statvfs",		nixio_statvfs},
+#endif
+#ifdef __linux__
+	{"inotify",		nixio_inotify},
+	{"inotify_add",	nixio_inotify_add},
+	{"inotify_rm",	nixio_inotify_rm},
+	{"inotify_read",	nixio_inotify_read},
 #endif
 	{"chmod",		nixio_chmod},
 	{"access",		nixio_access},
@@ -544,6 +768,7 @@ static const luaL_reg R[] = {
 	{"remove",		nixio_remove},
 	{"stat",		nixio_stat},
 	{"lstat",		nixio_lstat},
+	{"readfile",	nixio_readfile},
 	{NULL,			NULL}
 };
 
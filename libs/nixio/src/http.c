@@ -0,0 +1,367 @@
+/*
+ * nixio - Linux I/O library for lua
+ *
+ *   Copyright (C) 2009 Steven Barth <steven@midlink.org>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "nixio.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <ctype.h>
+
+/* multipart parser states */
+enum {
+	NIXIO_MP_PREAMBLE,	/* skipping data in front of the first boundary */
+	NIXIO_MP_DELIM,		/* behind a boundary */
+	NIXIO_MP_HEADER,	/* reading part headers */
+	NIXIO_MP_BODY,		/* reading part data */
+	NIXIO_MP_DONE		/* behind the closing boundary */
+};
+
+typedef struct nixio_multipart {
+	int state;
+	nixio_buf buf;		/* unprocessed data */
+	size_t dlen;
+	char delim[1];		/* "\r\n--" boundary */
+} nixio_mp;
+
+/* length of a line without its terminating (CR)LF */
+static size_t nixio_http__linelen(const char *line, const char *lf) {
+	size_t len = lf - line;
+	return (len > 0 && line[len - 1] == '\r') ? len - 1 : len;
+}
+
+/**
+ * Parse "METHOD URI HTTP/1.x" and push its three components
+ */
+static int nixio_http__reqline(lua_State *L, const char *line, size_t len) {
+	const char *end = line + len, *uri, *proto;
+
+	if (len < 12) {
+		return -1;
+	}
+
+	for (uri = line; uri < end && *uri >= 'A' && *uri <= 'Z'; uri++);
+	if (uri == line || uri == end || *uri != ' ') {
+		return -1;
+	}
+
+	proto = end - 8;
+	if (proto - uri < 3 || proto[-1] != ' ' || memcmp(proto, "HTTP/1.", 7)
+	|| (proto[7] != '0' && proto[7] != '1') || memchr(uri + 1, ' ',
+	proto - uri - 2)) {
+		return -1;
+	}
+
+	lua_pushlstring(L, line, uri - line);
+	lua_pushlstring(L, uri + 1, proto - uri - 2);
+	lua_pushlstring(L, proto, 8);
+	return 0;
+}
+
+/**
+ * Parse "Key: Value" and store it in the table on top of the stack
+ */
+static int nixio_http__header(lua_State *L, const char *line, size_t len) {
+	const char *end = line + len, *key = line, *val;
+
+	for (val = key; val < end && (isalnum((unsigned char)*val)
+	|| *val == '-'); val++);
+	if (val == key) {
+		return -1;
+	}
+	lua_pushlstring(L, key, val - key);
+
+	if (val < end && isspace((unsigned char)*val)) {
+		val++;
+	}
+	if (val == end || *val++ != ':') {
+		lua_pop(L, 1);
+		return -1;
+	}
+	if (val < end && isspace((unsigned char)*val)) {
+		val++;
+	}
+
+	lua_pushlstring(L, val, end - val);
+	lua_rawset(L, -3);
+	return 0;
+}
+
+/**
+ * nixio.http_request(buffer, limit)
+ */
+static int nixio_http_request(lua_State *L) {
+	nixio_buf *buf = nixio__checkbuffer(L, 1);
+	size_t limit = luaL_optinteger(L, 2, NIXIO_BUFFERSIZE);
+	const char *start, *end, *line, *lf;
+	size_t headlen;
+
+	/* ignore empty lines in front of the request */
+	start = buf->data + buf->rpos;
+	end = buf->data + buf->wpos;
+	while (start < end && (*start == '\n' || (*start == '\r'
+	&& start + 1 < end && start[1] == '\n'))) {
+		start += (*start == '\r') ? 2 : 1;
+	}
+	nixio__buffer_consume(buf, start - (buf->data + buf->rpos));
+	start = buf->data + buf->rpos;
+	end = buf->data + buf->wpos;
+
+	/* locate the empty line terminating the header */
+	for (line = start; (lf = memchr(line, '\n', end - line)); line = lf + 1) {
+		if (line != start && nixio_http__linelen(line, lf) == 0) {
+			break;
+		}
+	}
+
+	if (!lf || (size_t)(lf + 1 - start) > limit) {
+		if ((size_t)(end - start) < limit && !lf) {
+			lua_pushboolean(L, 0);		/* incomplete */
+			return 1;
+		}
+		lua_pushnil(L);
+		lua_pushliteral(L, "header too large");
+		return 2;
+	}
+	headlen = lf + 1 - start;
+	end = line;		/* the empty line */
+
+	lf = memchr(start, '\n', end - start);
+	if (nixio_http__reqline(L, start, nixio_http__linelen(start, lf))) {
+		lua_pushnil(L);
+		lua_pushliteral(L, "invalid magic");
+		return 2;
+	}
+
+	lua_newtable(L);
+	for (line = lf + 1; line < end; line = lf + 1) {
+		lf = memchr(line, '\n', end - line);
+		if (nixio_http__header(L, line, nixio_http__linelen(line, lf))) {
+			lua_pushnil(L);
+			lua_pushliteral(L, "invalid header line");
+			return 2;
+		}
+	}
+
+	nixio__buffer_consume(buf, headlen);
+	return 4;
+}
+
+/**
+ * nixio.multipart(boundary)
+ */
+static int nixio_multipart(lua_State *L) {
+	size_t len;
+	const char *boundary = luaL_checklstring(L, 1, &len);
+	luaL_argcheck(L, len > 0 && len <= 200, 1, "invalid boundary");
+
+	nixio_mp *mp = lua_newuserdata(L, sizeof(nixio_mp) + len + 4);
+	mp->state = NIXIO_MP_PREAMBLE;
+	mp->buf.data = NULL;
+	mp->buf.size = mp->buf.rpos = mp->buf.wpos = 0;
+	mp->dlen = len + 4;
+	memcpy(mp->delim, "\r\n--", 4);
+	memcpy(mp->delim + 4, boundary, len);
+
+	luaL_getmetatable(L, NIXIO_MULTIPART_META);
+	lua_setmetatable(L, -2);
+
+	/* the first boundary is not preceded by a line break */
+	if (nixio__buffer_reserve(&mp->buf, 2)) {
+		return luaL_error(L, NIXIO_OOM);
+	}
+	memcpy(mp->buf.data, "\r\n", 2);
+	mp->buf.wpos = 2;
+
+	return 1;
+}
+
+/* locate a string in a memory area */
+static const char* nixio_multipart__find(const char *pos, const char *end,
+const char *str, size_t len) {
+	while (end - pos >= (ptrdiff_t)len) {
+		pos = memchr(pos, str[0], end - pos - len + 1);
+		if (!pos) {
+			return NULL;
+		} else if (!memcmp(pos, str, len)) {
+			return pos;
+		}
+		pos++;
+	}
+	return NULL;
+}
+
+/* invoke the callback, returns 0 if it asks to stop */
+static int nixio_multipart__call(lua_State *L, const char *event,
+const char *data, size_t len, int eof) {
+	lua_pushvalue(L, 3);
+	lua_pushstring(L, event);
+	lua_pushlstring(L, data, len);
+	lua_pushboolean(L, eof);
+	lua_call(L, 3, 2);
+	if (lua_toboolean(L, -2)) {
+		lua_pop(L, 2);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * parser:parse(chunk, callback)
+ */
+static int nixio_multipart_parse(lua_State *L) {
+	nixio_mp *mp = luaL_checkudata(L, 1, NIXIO_MULTIPART_META);
+	nixio_buf *buf = &mp->buf;
+	size_t len;
+	const char *chunk = luaL_optlstring(L, 2, NULL, &len);
+	const char *data, *end, *pos;
+	size_t avail, skip;
+	luaL_checktype(L, 3, LUA_TFUNCTION);
+
+	if (chunk && len > 0 && mp->state != NIXIO_MP_DONE) {
+		if (nixio__buffer_reserve(buf, len)) {
+			return luaL_error(L, NIXIO_OOM);
+		}
+		memcpy(buf->data + buf->wpos, chunk, len);
+		buf->wpos += len;
+	}
+
+	for (;;) {
+		data = buf->data + buf->rpos;
+		end = buf->data + buf->wpos;
+		avail = end - data;
+
+		switch (mp->state) {
+		case NIXIO_MP_PREAMBLE:
+			pos = nixio_multipart__find(data, end, mp->delim, mp->dlen);
+			if (!pos) {
+				/* keep what could be the start of a boundary */
+				if (avail >= mp->dlen) {
+					nixio__buffer_consume(buf, avail - mp->dlen + 1);
+				}
+				goto done;
+			}
+			nixio__buffer_consume(buf, pos - data + mp->dlen);
+			mp->state = NIXIO_MP_DELIM;
+			break;
+
+		case NIXIO_MP_DELIM:
+			if (avail < 2) {
+				goto done;
+			} else if (!memcmp(data, "--", 2)) {
+				nixio__buffer_consume(buf, avail);
+				mp->state = NIXIO_MP_DONE;
+				goto done;
+			} else if (memcmp(data, "\r\n", 2)) {
+				lua_pushnil(L);
+				lua_pushliteral(L, "Invalid MIME boundary");
+				return 2;
+			}
+			nixio__buffer_consume(buf, 2);
+			mp->state = NIXIO_MP_HEADER;
+			break;
+
+		case NIXIO_MP_HEADER:
+			if (avail >= 2 && !memcmp(data, "\r\n", 2)) {
+				len = 0, skip = 2;
+			} else if ((pos = nixio_multipart__find(data, end, "\r\n\r\n", 4))) {
+				len = pos + 2 - data, skip = len + 2;
+			} else if (avail > NIXIO_BUFFERSIZE) {
+				lua_pushnil(L);
+				lua_pushliteral(L, "Invalid MIME section header");
+				return 2;
+			} else {
+				goto done;
+			}
+			if (!nixio_multipart__call(L, "header", data, len, 0)) {
+				return 2;
+			}
+			nixio__buffer_consume(buf, skip);
+			mp->state = NIXIO_MP_BODY;
+			break;
+
+		case NIXIO_MP_BODY:
+			pos = nixio_multipart__find(data, end, mp->delim, mp->dlen);
+			if (pos) {
+				if (!nixio_multipart__call(L, "data", data, pos - data, 1)) {
+					return 2;
+				}
+				nixio__buffer_consume(buf, pos - data + mp->dlen);
+				mp->state = NIXIO_MP_DELIM;
+				break;
+			}
+
+			/* pass on everything that cannot be part of a boundary,
+			 * small chunks are collected first */
+			len = (!chunk) ? avail
+				: (avail >= mp->dlen + NIXIO_BUFFERSIZE) ? avail - mp->dlen + 1 : 0;
+			if (len > 0) {
+				if (!nixio_multipart__call(L, "data", data, len, 0)) {
+					return 2;
+				}
+				nixio__buffer_consume(buf, len);
+			}
+			goto done;
+
+		default:
+			goto done;
+		}
+	}
+
+done:
+	lua_pushboolean(L, 1);
+	return 1;
+}
+
+static int nixio_multipart__gc(lua_State *L) {
+	nixio_mp *mp = luaL_checkudata(L, 1, NIXIO_MULTIPART_META);
+	free(mp->buf.data);
+	mp->buf.data = NULL;
+	mp->buf.size = mp->buf.rpos = mp->buf.wpos = 0;
+	return 0;
+}
+
+static int nixio_multipart__tostring(lua_State *L) {
+	lua_pushfstring(L, "nixio multipart parser %p", lua_touserdata(L, 1));
+	return 1;
+}
+
+
+/* module table */
+static const luaL_reg R[] = {
+	{"http_request",	nixio_http_request},
+	{"multipart",		nixio_multipart},
+	{NULL,			NULL}
+};
+
+/* multipart parser object table */
+static const luaL_reg M[] = {
+	{"parse",		nixio_multipart_parse},
+	{"__gc",		nixio_multipart__gc},
+	{"__tostring",	nixio_multipart__tostring},
+	{NULL,			NULL}
+};
+
+void nixio_open_http(lua_State *L) {
+	luaL_register(L, NULL, R);
+
+	luaL_newmetatable(L, NIXIO_MULTIPART_META);
+	luaL_register(L, NULL, M);
+	lua_pushvalue(L, -1);
+	lua_setfield(L, -2, "__index");
+	lua_setfield(L, -2, "meta_multipart");
+}
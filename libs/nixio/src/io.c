@@ -122,7 +122,8 @@ static int nixio_sock_sendto(lua_State *L) {
  */
 static int nixio_sock__recvfrom(lua_State *L, int from) {
 	nixio_sock *sock = nixio__checksock(L);
-	char buffer[NIXIO_BUFFERSIZE];
+	char stackbuf[NIXIO_BUFFERSIZE];
+	char *buffer = stackbuf;
 	struct sockaddr_storage addr_in;
 #ifndef __WINNT__
 	struct sockaddr_un addr_un;
@@ -143,8 +144,13 @@ static int nixio_sock__recvfrom(lua_State *L, int from) {
 	}
 #endif
 
-	/* We limit the readsize to NIXIO_BUFFERSIZE */
-	req = (req > NIXIO_BUFFERSIZE) ? NIXIO_BUFFERSIZE : req;
+	/* Large reads go to the heap, limited to NIXIO_READMAX */
+	if (req > NIXIO_BUFFERSIZE) {
+		req = (req > NIXIO_READMAX) ? NIXIO_READMAX : req;
+		if (!(buffer = malloc(req))) {
+			return luaL_error(L, NIXIO_OOM);
+		}
+	}
 
 	do {
 		readc = recvfrom(sock->fd, buffer, req, 0, addr, &alen);
@@ -159,11 +165,16 @@ static int nixio_sock__recvfrom(lua_State *L, int from) {
 	}
 #endif
 
+	if (readc >= 0) {
+		lua_pushlstring(L, buffer, readc);
+	}
+	if (buffer != stackbuf) {
+		free(buffer);
+	}
+
 	if (readc < 0) {
 		return nixio__perror_s(L);
 	} else {
-		lua_pushlstring(L, buffer, readc);
-
 		if (!from) {
 			return 1;
 		}
@@ -136,6 +136,10 @@ NIXIO_API int luaopen_nixio(lua_State *L) {
 	nixio_open_protoent(L);
 	nixio_open_poll(L);
 	nixio_open_io(L);
+	nixio_open_buffer(L);
+	nixio_open_chunked(L);
+	nixio_open_http(L);
+	nixio_open_pack(L);
 	nixio_open_splice(L);
 	nixio_open_process(L);
 	nixio_open_syslog(L);
@@ -166,6 +170,9 @@ NIXIO_API int luaopen_nixio(lua_State *L) {
 	lua_pushinteger(L, NIXIO_BUFFERSIZE);
 	lua_setfield(L, -2, "buffersize");
 
+	lua_pushinteger(L, NIXIO_READMAX);
+	lua_setfield(L, -2, "readmax");
+
 	NIXIO_PUSH_CONSTANT(EACCES);
 	NIXIO_PUSH_CONSTANT(EINTR);
 	NIXIO_PUSH_CONSTANT(ENOSYS);
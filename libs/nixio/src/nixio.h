@@ -7,6 +7,11 @@
 #define NIXIO_FILE_META "nixio.file"
 #define NIXIO_GLOB_META "nixio.glob"
 #define NIXIO_DIR_META "nixio.dir"
+#define NIXIO_EPOLL_META "nixio.epoll"
+#define NIXIO_BUFFER_META "nixio.buffer"
+#define NIXIO_CHUNKED_META "nixio.chunked"
+#define NIXIO_MULTIPART_META "nixio.multipart"
+#define NIXIO_PACK_META "nixio.pack"
 #define _FILE_OFFSET_BITS 64
 
 #define NIXIO_PUSH_CONSTANT(x) \
@@ -20,8 +25,10 @@
 #include <lualib.h>
 #include <lauxlib.h>
 #include <luaconf.h>
+#include <stdint.h>
 
 #define NIXIO_BUFFERSIZE 8192
+#define NIXIO_READMAX (16 * 1024 * 1024)
 
 typedef struct nixio_socket {
 	int fd;
@@ -37,6 +44,13 @@ typedef struct nixio_address {
 	int prefix;
 } nixio_addr;
 
+typedef struct nixio_buffer {
+	char *data;
+	size_t size;
+	size_t rpos;		/* read cursor */
+	size_t wpos;		/* write cursor, end of the buffered data */
+} nixio_buf;
+
 int nixio__perror(lua_State *L);
 int nixio__pstatus(lua_State *L, int condition);
 
@@ -95,6 +109,10 @@ int nixio__checkfd(lua_State *L, int ud);
 int nixio__tofd(lua_State *L, int ud);
 int nixio__nulliter(lua_State *L);
 
+nixio_buf* nixio__checkbuffer(lua_State *L, int idx);
+int nixio__buffer_reserve(nixio_buf *buf, size_t len);
+void nixio__buffer_consume(nixio_buf *buf, size_t len);
+
 int nixio__addr_parse(nixio_addr *addr, struct sockaddr *saddr);
 int nixio__addr_write(nixio_addr *addr, struct sockaddr *saddr);
 
@@ -104,6 +122,7 @@ int nixio__mode_write(int mode, char *modestr);
 int nixio__push_stat(lua_State *L, nixio_stat_t *buf);
 
 const char nixio__bin2hex[16];
+uint32_t nixio__crc32(const char *buffer, size_t len, uint32_t value);
 
 /* Module functions */
 void nixio_open_file(lua_State *L);
@@ -114,6 +133,10 @@ void nixio_open_address(lua_State *L);
 void nixio_open_protoent(lua_State *L);
 void nixio_open_poll(lua_State *L);
 void nixio_open_io(lua_State *L);
+void nixio_open_buffer(lua_State *L);
+void nixio_open_chunked(lua_State *L);
+void nixio_open_http(lua_State *L);
+void nixio_open_pack(lua_State *L);
 void nixio_open_splice(lua_State *L);
 void nixio_open_process(lua_State *L);
 void nixio_open_syslog(lua_State *L);
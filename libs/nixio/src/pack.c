@@ -0,0 +1,266 @@
+/*
+ * nixio - Linux I/O library for lua
+ *
+ *   Copyright (C) 2009 Steven Barth <steven@midlink.org>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "nixio.h"
+#include <errno.h>
+#include <string.h>
+
+#ifndef __WINNT__
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+/*
+ * Module pack layout, all integers are 32 bit little endian:
+ *
+ * "LUCIPACK" count
+ * count * (hash name_offset name_length code_offset code_length)
+ * names and code
+ *
+ * The index is sorted by hash, the crc32 of the name.
+ */
+#define NIXIO_PACK_MAGIC	"LUCIPACK"
+#define NIXIO_PACK_HEADER	12
+#define NIXIO_PACK_ENTRY	20
+
+typedef struct nixio_pack {
+	const unsigned char *data;
+	size_t size;
+	uint32_t count;
+} nixio_pack_t;
+
+static nixio_pack_t* nixio__checkpack(lua_State *L) {
+	nixio_pack_t *pk = luaL_checkudata(L, 1, NIXIO_PACK_META);
+	luaL_argcheck(L, pk->data, 1, "invalid pack object");
+	return pk;
+}
+
+static uint32_t nixio_pack__u32(const unsigned char *p) {
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static const unsigned char* nixio_pack__entry(nixio_pack_t *pk, uint32_t i) {
+	return pk->data + NIXIO_PACK_HEADER + i * NIXIO_PACK_ENTRY;
+}
+
+static void nixio_pack__unmap(nixio_pack_t *pk) {
+	if (pk->data) {
+		munmap((void *)pk->data, pk->size);
+		pk->data = NULL;
+		pk->size = pk->count = 0;
+	}
+}
+
+/**
+ * Look up a name, returns its index entry or NULL
+ */
+static const unsigned char* nixio_pack__find(nixio_pack_t *pk,
+const char *name, size_t len) {
+	uint32_t hash = nixio__crc32(name, len, 0);
+	uint32_t lo = 0, hi = pk->count, mid;
+	const unsigned char *e;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (nixio_pack__u32(nixio_pack__entry(pk, mid)) < hash) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	for (; lo < pk->count; lo++) {
+		e = nixio_pack__entry(pk, lo);
+		if (nixio_pack__u32(e) != hash) {
+			break;
+		} else if (nixio_pack__u32(e + 8) == len
+		&& !memcmp(pk->data + nixio_pack__u32(e + 4), name, len)) {
+			return e;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * nixio.openpack(path)
+ */
+static int nixio_openpack(lua_State *L) {
+	const char *path = luaL_checkstring(L, 1);
+	const unsigned char *e;
+	nixio_stat_t st;
+	uint32_t i, count, off, len;
+	void *map;
+	int fd;
+
+	nixio_pack_t *pk = lua_newuserdata(L, sizeof(nixio_pack_t));
+	pk->data = NULL;
+	pk->size = pk->count = 0;
+
+	luaL_getmetatable(L, NIXIO_PACK_META);
+	lua_setmetatable(L, -2);
+
+	do {
+		fd = open(path, O_RDONLY);
+	} while (fd == -1 && errno == EINTR);
+	if (fd == -1) {
+		return nixio__perror(L);
+	}
+
+	if (fstat(fd, &st)) {
+		close(fd);
+		return nixio__perror(L);
+	} else if (st.st_size < NIXIO_PACK_HEADER || st.st_size > UINT32_MAX) {
+		close(fd);
+		goto invalid;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		return nixio__perror(L);
+	}
+	pk->data = map;
+	pk->size = st.st_size;
+
+	/* validate the whole index once so lookups need no bounds checks */
+	count = nixio_pack__u32(pk->data + 8);
+	if (memcmp(pk->data, NIXIO_PACK_MAGIC, 8)
+	|| count > (pk->size - NIXIO_PACK_HEADER) / NIXIO_PACK_ENTRY) {
+		goto invalid;
+	}
+
+	for (i = 0; i < count; i++) {
+		e = nixio_pack__entry(pk, i);
+		if (i > 0 && nixio_pack__u32(e) < nixio_pack__u32(e - NIXIO_PACK_ENTRY)) {
+			goto invalid;
+		}
+		for (e += 4; e < nixio_pack__entry(pk, i + 1); e += 8) {
+			off = nixio_pack__u32(e);
+			len = nixio_pack__u32(e + 4);
+			if (off > pk->size || len > pk->size - off) {
+				goto invalid;
+			}
+		}
+	}
+
+	pk->count = count;
+	return 1;
+
+invalid:
+	nixio_pack__unmap(pk);
+	lua_pushnil(L);
+	lua_pushliteral(L, "invalid module pack");
+	return 2;
+}
+
+/**
+ * pack:load(name)
+ */
+static int nixio_pack_load(lua_State *L) {
+	nixio_pack_t *pk = nixio__checkpack(L);
+	size_t len;
+	const char *name = luaL_checklstring(L, 2, &len);
+	const unsigned char *e = nixio_pack__find(pk, name, len);
+
+	if (!e) {
+		return 0;
+	}
+
+	/* the chunk is undumped straight from the mapping */
+	if (luaL_loadbuffer(L, (const char *)pk->data + nixio_pack__u32(e + 12),
+	nixio_pack__u32(e + 16), name)) {
+		lua_pushnil(L);
+		lua_insert(L, -2);
+		return 2;
+	}
+
+	return 1;
+}
+
+/**
+ * pack:names()
+ */
+static int nixio_pack_names(lua_State *L) {
+	nixio_pack_t *pk = nixio__checkpack(L);
+	const unsigned char *e;
+	uint32_t i;
+
+	lua_createtable(L, pk->count, 0);
+	for (i = 0; i < pk->count; i++) {
+		e = nixio_pack__entry(pk, i);
+		lua_pushlstring(L, (const char *)pk->data + nixio_pack__u32(e + 4),
+				nixio_pack__u32(e + 8));
+		lua_rawseti(L, -2, i + 1);
+	}
+
+	return 1;
+}
+
+/**
+ * pack:close()
+ */
+static int nixio_pack_close(lua_State *L) {
+	nixio_pack__unmap(nixio__checkpack(L));
+	lua_pushboolean(L, 1);
+	return 1;
+}
+
+static int nixio_pack__gc(lua_State *L) {
+	nixio_pack__unmap(luaL_checkudata(L, 1, NIXIO_PACK_META));
+	return 0;
+}
+
+static int nixio_pack__tostring(lua_State *L) {
+	lua_pushfstring(L, "nixio module pack %p", lua_touserdata(L, 1));
+	return 1;
+}
+
+
+/* module table */
+static const luaL_reg R[] = {
+	{"openpack",	nixio_openpack},
+	{NULL,			NULL}
+};
+
+/* pack object table */
+static const luaL_reg M[] = {
+	{"load",		nixio_pack_load},
+	{"names",		nixio_pack_names},
+	{"close",		nixio_pack_close},
+	{"__gc",		nixio_pack__gc},
+	{"__tostring",	nixio_pack__tostring},
+	{NULL,			NULL}
+};
+
+void nixio_open_pack(lua_State *L) {
+	luaL_register(L, NULL, R);
+
+	luaL_newmetatable(L, NIXIO_PACK_META);
+	luaL_register(L, NULL, M);
+	lua_pushvalue(L, -1);
+	lua_setfield(L, -2, "__index");
+	lua_setfield(L, -2, "meta_pack");
+}
+
+#else /* __WINNT__ */
+
+void nixio_open_pack(lua_State *L) {
+}
+
+#endif /* !__WINNT__ */
@@ -21,8 +21,33 @@
 #include <errno.h>
 #include <string.h>
 #include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <sys/time.h>
 
+#if defined(__linux__) && !defined(NO_EPOLL)
+#include <sys/epoll.h>
+#define NIXIO_EPOLL 1
+#endif
+
+/* registration modes of nixio.epoll() */
+#define NIXIO_EP_EDGE		0x01
+#define NIXIO_EP_ONESHOT	0x02
+
+typedef struct nixio_epoll {
+	int fd;					/* epoll instance, -1 for the poll() fallback */
+	int closed;
+	int maxevents;
+	int nready;				/* ready entries stored by the last wait */
+	int count;				/* poll() fallback: registered descriptors */
+	int size;
+	struct pollfd *fds;		/* negative fds are disarmed one-shot entries */
+	int *modes;
+#ifdef NIXIO_EPOLL
+	struct epoll_event *events;
+#endif
+} nixio_ep;
+
 
 static int nixio_gettimeofday(lua_State *L) {
 	struct timeval tv;
@@ -196,15 +221,326 @@ static int nixio_poll(lua_State *L) {
 	return 2;
 }
 
+static nixio_ep* nixio__checkepoll(lua_State *L) {
+	nixio_ep *ep = luaL_checkudata(L, 1, NIXIO_EPOLL_META);
+	luaL_argcheck(L, !ep->closed, 1, "invalid epoll object");
+	return ep;
+}
+
+static int nixio_epoll__mode(lua_State *L, int idx) {
+	const char *mode = luaL_optstring(L, idx, "level");
+	int flags = 0;
+	if (strstr(mode, "edge")) {
+		flags |= NIXIO_EP_EDGE;
+	}
+	if (strstr(mode, "oneshot")) {
+		flags |= NIXIO_EP_ONESHOT;
+	}
+	return flags;
+}
+
+/* find a registered descriptor in the poll() fallback set */
+static int nixio_epoll__find(nixio_ep *ep, int fd) {
+	for (int i = 0; i < ep->count; i++) {
+		if (ep->fds[i].fd == fd || ep->fds[i].fd == ~fd) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+/**
+ * epoll([maxevents])
+ */
+static int nixio_epoll(lua_State *L) {
+	int maxevents = luaL_optint(L, 1, 64);
+	luaL_argcheck(L, maxevents > 0, 1, "invalid number of events");
+
+	nixio_ep *ep = lua_newuserdata(L, sizeof(nixio_ep));
+	memset(ep, 0, sizeof(nixio_ep));
+	ep->fd = -1;
+	ep->maxevents = maxevents;
+
+	luaL_getmetatable(L, NIXIO_EPOLL_META);
+	lua_setmetatable(L, -2);
+
+	/* environment holds the handler values by fd and the ready list */
+	lua_createtable(L, 2, 0);
+	lua_newtable(L);
+	lua_rawseti(L, -2, 1);
+	lua_newtable(L);
+	lua_rawseti(L, -2, 2);
+	lua_setfenv(L, -2);
+
+#ifdef NIXIO_EPOLL
+	ep->events = malloc(maxevents * sizeof(struct epoll_event));
+	if (!ep->events) {
+		return luaL_error(L, NIXIO_OOM);
+	}
+
+	ep->fd = epoll_create(maxevents);
+	if (ep->fd != -1) {
+		fcntl(ep->fd, F_SETFD, fcntl(ep->fd, F_GETFD) | FD_CLOEXEC);
+	}
+#endif
+
+	return 1;
+}
+
+static int nixio_epoll__ctl(lua_State *L, int add) {
+	nixio_ep *ep = nixio__checkepoll(L);
+	int fd = lua_isnumber(L, 2) ? lua_tointeger(L, 2) : nixio__checkfd(L, 2);
+	int events = luaL_checkinteger(L, 3);
+	int mode = nixio_epoll__mode(L, 5);
+	int i;
+
+#ifdef NIXIO_EPOLL
+	if (ep->fd != -1) {
+		struct epoll_event ev;
+		memset(&ev, 0, sizeof(ev));
+		ev.events = (events & ~POLLNVAL)
+			| ((mode & NIXIO_EP_EDGE) ? EPOLLET : 0)
+			| ((mode & NIXIO_EP_ONESHOT) ? EPOLLONESHOT : 0);
+		ev.data.fd = fd;
+
+		if (epoll_ctl(ep->fd, add ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fd, &ev)) {
+			return nixio__perror(L);
+		}
+	} else
+#endif
+	{
+		i = nixio_epoll__find(ep, fd);
+		if (add && i != -1) {
+			errno = EEXIST;
+			return nixio__perror(L);
+		} else if (!add && i == -1) {
+			errno = ENOENT;
+			return nixio__perror(L);
+		}
+
+		if (add) {
+			if (ep->count == ep->size) {
+				int size = ep->size ? ep->size * 2 : 16;
+				struct pollfd *fds = realloc(ep->fds, size * sizeof(*fds));
+				if (fds) {
+					ep->fds = fds;
+				}
+				int *modes = realloc(ep->modes, size * sizeof(*modes));
+				if (modes) {
+					ep->modes = modes;
+				}
+				if (!fds || !modes) {
+					return luaL_error(L, NIXIO_OOM);
+				}
+				ep->size = size;
+			}
+			i = ep->count++;
+		}
+
+		ep->fds[i].fd = fd;
+		ep->fds[i].events = (short)events;
+		ep->fds[i].revents = 0;
+		ep->modes[i] = mode;
+	}
+
+	/* remember the associated value, defaults to the descriptor itself */
+	i = (add && lua_isnoneornil(L, 4)) ? 2 : 4;
+	if (!lua_isnoneornil(L, i)) {
+		lua_getfenv(L, 1);
+		lua_rawgeti(L, -1, 1);
+		lua_pushvalue(L, i);
+		lua_rawseti(L, -2, fd);
+		lua_pop(L, 2);
+	}
+
+	lua_pushboolean(L, 1);
+	return 1;
+}
+
+/**
+ * epoll:add(fd, events, value, mode)
+ */
+static int nixio_epoll_add(lua_State *L) {
+	return nixio_epoll__ctl(L, 1);
+}
+
+/**
+ * epoll:modify(fd, events, value, mode)
+ */
+static int nixio_epoll_modify(lua_State *L) {
+	return nixio_epoll__ctl(L, 0);
+}
+
+/**
+ * epoll:remove(fd)
+ */
+static int nixio_epoll_remove(lua_State *L) {
+	nixio_ep *ep = nixio__checkepoll(L);
+	int fd = lua_isnumber(L, 2) ? lua_tointeger(L, 2) : nixio__checkfd(L, 2);
+
+#ifdef NIXIO_EPOLL
+	if (ep->fd != -1) {
+		struct epoll_event ev;
+		if (epoll_ctl(ep->fd, EPOLL_CTL_DEL, fd, &ev)) {
+			return nixio__perror(L);
+		}
+	} else
+#endif
+	{
+		int i = nixio_epoll__find(ep, fd);
+		if (i == -1) {
+			errno = ENOENT;
+			return nixio__perror(L);
+		}
+		ep->count--;
+		ep->fds[i] = ep->fds[ep->count];
+		ep->modes[i] = ep->modes[ep->count];
+	}
+
+	lua_getfenv(L, 1);
+	lua_rawgeti(L, -1, 1);
+	lua_pushnil(L);
+	lua_rawseti(L, -2, fd);
+	lua_pop(L, 2);
+
+	lua_pushboolean(L, 1);
+	return 1;
+}
+
+/**
+ * epoll:wait(timeout)
+ */
+static int nixio_epoll_wait(lua_State *L) {
+	nixio_ep *ep = nixio__checkepoll(L);
+	int timeout = luaL_optint(L, 2, 0);
+	int i, n = 0, status;
+
+	lua_getfenv(L, 1);
+	lua_rawgeti(L, -1, 1);
+	lua_rawgeti(L, -2, 2);
+
+#ifdef NIXIO_EPOLL
+	if (ep->fd != -1) {
+		status = epoll_wait(ep->fd, ep->events, ep->maxevents, timeout);
+		if (status < 0) {
+			return nixio__perror(L);
+		}
+
+		for (n = 0; n < status; n++) {
+			lua_rawgeti(L, -2, ep->events[n].data.fd);
+			lua_rawseti(L, -2, 2 * n + 1);
+			lua_pushinteger(L, ep->events[n].events);
+			lua_rawseti(L, -2, 2 * n + 2);
+		}
+	} else
+#endif
+	{
+		status = poll(ep->fds, (nfds_t)ep->count, timeout);
+		if (status < 0) {
+			return nixio__perror(L);
+		}
+
+		for (i = 0; i < ep->count && n < status; i++) {
+			if (!ep->fds[i].revents) {
+				continue;
+			}
+
+			lua_rawgeti(L, -2, ep->fds[i].fd);
+			lua_rawseti(L, -2, 2 * n + 1);
+			lua_pushinteger(L, ep->fds[i].revents);
+			lua_rawseti(L, -2, 2 * n + 2);
+			n++;
+
+			/* disarm one-shot entries until they are modified again */
+			if (ep->modes[i] & NIXIO_EP_ONESHOT) {
+				ep->fds[i].fd = ~ep->fds[i].fd;
+			}
+			ep->fds[i].revents = 0;
+		}
+	}
+
+	/* clear the entries left over from the previous call */
+	for (i = 2 * n + 1; i <= 2 * ep->nready; i++) {
+		lua_pushnil(L);
+		lua_rawseti(L, -2, i);
+	}
+	ep->nready = n;
+
+	lua_pushinteger(L, n);
+	lua_insert(L, -2);
+	return 2;
+}
+
+static int nixio_epoll_backend(lua_State *L) {
+	nixio_ep *ep = nixio__checkepoll(L);
+	lua_pushstring(L, (ep->fd != -1) ? "epoll" : "poll");
+	return 1;
+}
+
+static int nixio_epoll_fileno(lua_State *L) {
+	lua_pushinteger(L, nixio__checkepoll(L)->fd);
+	return 1;
+}
+
+static int nixio_epoll__gc(lua_State *L) {
+	nixio_ep *ep = luaL_checkudata(L, 1, NIXIO_EPOLL_META);
+	if (!ep->closed) {
+		ep->closed = 1;
+		if (ep->fd != -1) {
+			close(ep->fd);
+			ep->fd = -1;
+		}
+		free(ep->fds);
+		free(ep->modes);
+#ifdef NIXIO_EPOLL
+		free(ep->events);
+#endif
+	}
+	return 0;
+}
+
+static int nixio_epoll_close(lua_State *L) {
+	nixio__checkepoll(L);
+	nixio_epoll__gc(L);
+	lua_pushboolean(L, 1);
+	return 1;
+}
+
+static int nixio_epoll__tostring(lua_State *L) {
+	lua_pushfstring(L, "nixio epoll %p", lua_touserdata(L, 1));
+	return 1;
+}
+
+/* method table */
+static const luaL_reg M[] = {
+	{"add",			nixio_epoll_add},
+	{"modify",		nixio_epoll_modify},
+	{"remove",		nixio_epoll_remove},
+	{"wait",		nixio_epoll_wait},
+	{"backend",		nixio_epoll_backend},
+	{"fileno",		nixio_epoll_fileno},
+	{"close",		nixio_epoll_close},
+	{"__gc",		nixio_epoll__gc},
+	{"__tostring",	nixio_epoll__tostring},
+	{NULL,			NULL}
+};
+
 /* module table */
 static const luaL_reg R[] = {
 	{"gettimeofday", nixio_gettimeofday},
 	{"nanosleep",	nixio_nanosleep},
 	{"poll",		nixio_poll},
 	{"poll_flags",	nixio_poll_flags},
+	{"epoll",		nixio_epoll},
 	{NULL,			NULL}
 };
 
 void nixio_open_poll(lua_State *L) {
 	luaL_register(L, NULL, R);
+
+	luaL_newmetatable(L, NIXIO_EPOLL_META);
+	luaL_register(L, NULL, M);
+	lua_pushvalue(L, -1);
+	lua_setfield(L, -2, "__index");
+	lua_pop(L, 1);
 }
@@ -160,6 +160,67 @@ static int nixio_sendfile(lua_State *L) {
 	return 1;
 }
 
+/**
+ * sendfile_range(sock, file, offset, length, [timeout])
+ */
+static int nixio_sendfile_range(lua_State *L) {
+	int sock = nixio__checksockfd(L);
+	int infd = nixio__checkfd(L, 2);
+	off_t offset = (off_t)nixio__checknumber(L, 3);
+	off_t len = (off_t)nixio__checknumber(L, 4);
+	int timeout = luaL_optint(L, 5, -1);
+	struct pollfd pfd = { .fd = sock, .events = POLLOUT };
+	off_t sent = 0, chunk;
+	int r, error = 0;
+
+	while (sent < len) {
+#ifndef BSD
+		r = sendfile(sock, infd, &offset, len - sent);
+		chunk = (r > 0) ? r : 0;
+#else
+		chunk = len - sent;
+#ifdef __DARWIN__
+		r = sendfile(infd, sock, offset, &chunk, NULL, 0);
+#else
+		r = sendfile(infd, sock, offset, chunk, NULL, &chunk, 0);
+#endif
+		if (r == -1 && errno != EAGAIN && errno != EINTR) {
+			chunk = 0;
+		}
+		offset += chunk;
+#endif
+		sent += chunk;
+
+		if (r == -1 && errno == EAGAIN && !chunk) {
+			/* wait for the socket to drain */
+			do {
+				r = poll(&pfd, 1, timeout);
+			} while (r == -1 && errno == EINTR);
+			if (r == 0) {
+				errno = EAGAIN;
+			}
+			if (r < 1) {
+				error = 1;
+				break;
+			}
+		} else if (r == -1 && errno != EAGAIN && errno != EINTR) {
+			error = 1;
+			break;
+		} else if (r != -1 && !chunk) {
+			break;		/* end of file */
+		}
+	}
+
+	if (error) {
+		nixio__perror(L);
+		nixio__pushnumber(L, sent);
+		return 4;
+	}
+
+	nixio__pushnumber(L, sent);
+	return 1;
+}
+
 /* module table */
 static const luaL_reg R[] = {
 #ifdef _GNU_SOURCE
@@ -169,6 +230,7 @@ static const luaL_reg R[] = {
 #endif
 #endif
 	{"sendfile",		nixio_sendfile},
+	{"sendfile_range",	nixio_sendfile_range},
 	{NULL,			NULL}
 };
 
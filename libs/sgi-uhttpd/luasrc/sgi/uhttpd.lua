@@ -23,6 +23,9 @@ require "luci.sys"
 require "luci.dispatcher"
 require "luci.ltn12"
 
+luci.dispatcher.treecache = "/tmp/luci-treecache"
+luci.dispatcher.lazytree = true
+
 function handle_request(env)
 	exectime = os.clock()
 	local renv = {
@@ -59,14 +62,27 @@ function handle_request(env)
 		return uhttpd.send(...)
 	end
 
+	-- small content writes are coalesced into larger chunks, uhttpd
+	-- terminates the chunked response itself
+	local encoder = env.HTTP_VERSION > 1.0 and nixio.chunked
+		and nixio.chunked(nixio.stdout)
+
 	local function sendc(...)
-		if env.HTTP_VERSION > 1.0 then
+		if encoder then
+			return encoder:write(...)
+		elseif env.HTTP_VERSION > 1.0 then
 			return uhttpd.sendc(...)
 		else
 			return uhttpd.send(...)
 		end
 	end
 
+	local function flush()
+		if encoder then
+			encoder:flush()
+		end
+	end
+
 	local req = luci.http.Request(
 		renv, recv, luci.ltn12.sink.file(io.stderr)
 	)
@@ -84,6 +100,7 @@ function handle_request(env)
 		local res, id, data1, data2 = coroutine.resume(x, req)
 
 		if not res then
+			flush()
 			send(env.SERVER_PROTOCOL)
 			send(" 500 Internal Server Error\r\n")
 			send("Content-Type: text/plain\r\n\r\n")
@@ -112,10 +129,14 @@ function handle_request(env)
 			elseif id == 4 then
 				sendc(tostring(data1 or ""))
 			elseif id == 5 then
+				flush()
 				active = false
 			elseif id == 6 then
+				flush()
 				data1:copyz(nixio.stdout, data2)
 			end
 		end
 	end
+
+	flush()
 end
@@ -13,11 +13,14 @@ http://www.apache.org/licenses/LICENSE-2.0
 $Id$
 ]]--
 
+local preload = require "luci.preload"
+local images = preload.enable()
+
 local config = require "luci.config"
 local ccache = require "luci.ccache"
 
 module "luci.cacheloader"
 
-if config.ccache and config.ccache.enable == "1" then
+if images == 0 and config.ccache and config.ccache.enable == "1" then
 	ccache.cache_ondemand()
 end
\ No newline at end of file
@@ -46,6 +46,17 @@ local index = nil
 -- Fastindex
 local fi
 
+-- Shared values referenced by name from tree snapshots
+local snapshotrefs
+
+-- Top-level nodes each controller contributes to, true if it changes the
+-- root level itself, recorded while building the full tree, and the time
+-- they were recorded at
+local scopes, scopesdate, recording
+
+-- Controller whose index is currently executed
+local building
+
 
 --- Build the URL relative to the server webroot from given virtual path.
 -- @param ...	Virtual path
@@ -230,6 +241,16 @@ function dispatch(request)
 		c = createtree()
 	end
 
+	-- a lazily built tree only covers a single top-level node
+	if c.scope and c.scope ~= (request[1] or "") then
+		c = createtree()
+	end
+
+	-- nodes holding functions are only placeholders in a tree snapshot
+	if c.snapshot and not _snapshotcomplete(c, request) then
+		c = createtree(true)
+	end
+
 	local track = {}
 	local args = {}
 	ctx.args = args
@@ -483,7 +504,7 @@ function createindex_fastindex(path, suffixes)
 	index = {}
 
 	if not fi then
-		fi = luci.fastindex.new("index")
+		fi = luci.fastindex.new("index", indexcache and indexcache .. ".fast")
 		for _, suffix in ipairs(suffixes) do
 			fi.add(path .. "*" .. suffix)
 			fi.add(path .. "*/*" .. suffix)
@@ -560,20 +581,321 @@ function createindex_plain(path, suffixes)
 	end
 end
 
+-- Latest modification time of the controllers and the configuration
+local function _treedate()
+	if context.treedate then
+		return context.treedate
+	end
+
+	local path = luci.util.libpath() .. "/controller/"
+	local date = 0
+
+	local function update(file)
+		local mtime = fs.stat(file, "mtime")
+		date = (mtime and mtime > date) and mtime or date
+	end
+
+	-- directory times cover removed controllers
+	update(path)
+	for _, pattern in ipairs({ "*", "*/*" }) do
+		local files = fs.glob(path .. pattern)
+		for file in files or function() end do
+			update(file)
+		end
+	end
+
+	-- uncommitted changes are appended to existing files in the savedir
+	for _, dir in ipairs({ uci.inst:get_confdir(), uci.inst:get_savedir() }) do
+		update(dir)
+		for file in fs.glob(dir .. "/*") or function() end do
+			update(file)
+		end
+	end
+
+	context.treedate = date
+	return date
+end
+
+-- Load the recorded controller scopes unless they are outdated
+local function _loadscopes()
+	local file = indexcache and indexcache .. ".scopes"
+	local cachedate = file and fs.stat(file, "mtime")
+	if not cachedate or cachedate <= _treedate() then
+		return nil
+	end
+
+	assert(
+		sys.process.info("uid") == fs.stat(file, "uid")
+		and fs.stat(file, "modestr") == "rw-------",
+		"Fatal: Indexcache is not sane!"
+	)
+
+	local loader = loadfile(file)
+	return loader and loader(), cachedate
+end
+
+-- Record the top-level node of a path for the controller being executed
+local function _record(path)
+	if recording and building then
+		if #path < 2 then
+			recording[building] = true
+		elseif recording[building] ~= true then
+			recording[building] = recording[building] or {}
+			recording[building][path[1]] = true
+		end
+	end
+end
+
+--- Load a snapshot of the dispatching tree unless the controllers or the
+-- configuration changed after it was written.
+-- @param file	Snapshot file
+-- @return		Dispatching tree or nil
+function loadtree(file)
+	local cachedate = fs.stat(file, "mtime")
+	if not cachedate or cachedate <= _treedate() then
+		return nil
+	end
+
+	assert(
+		sys.process.info("uid") == fs.stat(file, "uid")
+		and fs.stat(file, "modestr") == "rw-------",
+		"Fatal: Treecache is not sane!"
+	)
+
+	local snapshot = loadfile(file)
+	if not snapshot then
+		return nil
+	end
+
+	local ctx   = context
+	local cache = setmetatable({}, {__mode="v"})
+	local tree  = snapshot(snapshotrefs, cache)
+
+	-- paths the index functions declared through treedepend()
+	for path, mtime in pairs(tree.depends or {}) do
+		if (fs.stat(path, "mtime") or 0) ~= mtime then
+			return nil
+		end
+	end
+
+	ctx.treecache = cache
+	ctx.tree = tree
+	ctx.modifiers = {}
+	tree.inreq = true
+	tree.snapshot = true
+
+	-- the nodes along the request path are "in request"
+	local name
+	for _, s in ipairs(ctx.path) do
+		name = name and name .. "." .. s or s
+		if not cache[name] then
+			break
+		end
+		cache[name].inreq = true
+	end
+
+	return tree
+end
+
+--- Write a snapshot of the dispatching tree as bytecode. Values which
+-- cannot be serialized are replaced by placeholders and their nodes are
+-- flagged, so that requests for them are served from a full tree.
+-- Nodes flagged by their controller are written without their children.
+-- @param file	Snapshot file
+-- @param tree	Dispatching tree
+function savetree(file, tree)
+	local refs = {}
+	for k, v in pairs(snapshotrefs) do
+		refs[v] = k
+	end
+
+	local nodes = {}
+	local function collect(node)
+		if not nodes[node] then
+			nodes[node] = true
+			if not rawget(node, "nosnapshot") then
+				for _, child in pairs(rawget(node, "nodes") or {}) do
+					collect(child)
+				end
+			end
+			local meta = getmetatable(node)
+			if meta and type(meta.__index) == "table" then
+				collect(meta.__index)
+			end
+		end
+	end
+	collect(tree)
+
+	local function portable(val, seen)
+		local t = type(val)
+		if refs[val] or t == "string" or t == "number" or t == "boolean" then
+			return true
+		elseif t ~= "table" or getmetatable(val) then
+			return false
+		end
+
+		seen = seen or {}
+		if not seen[val] then
+			seen[val] = true
+			for k, v in pairs(val) do
+				if not portable(k, seen) or not portable(v, seen) then
+					return false
+				end
+			end
+		end
+		return true
+	end
+
+	local ids, queue, code = {}, {}, {}
+	local function ref(val)
+		if refs[val] then
+			return "r[%q]" % refs[val]
+		elseif type(val) == "table" then
+			if not ids[val] then
+				queue[#queue+1] = val
+				ids[val] = #queue
+			end
+			return "n[%d]" % ids[val]
+		elseif type(val) == "string" then
+			return "%q" % val
+		elseif type(val) == "number" then
+			return "%.17g" % val
+		else
+			return tostring(val)
+		end
+	end
+
+	ref(tree)
+	local i = 1
+	while queue[i] do
+		local obj = queue[i]
+		local this = ref(obj)
+		local unsafe = false
+
+		local dynamic = nodes[obj] and rawget(obj, "nosnapshot")
+
+		for k, v in pairs(obj) do
+			if nodes[obj] and k ~= "nodes" and not portable(v) then
+				v, unsafe = true, true
+			end
+			if dynamic and k == "nodes" then
+				v = {}
+			end
+			if not nodes[obj] or k ~= "inreq" then
+				code[#code+1] = "%s[%s]=%s" %{ this, ref(k), ref(v) }
+			end
+		end
+
+		local meta = nodes[obj] and getmetatable(obj)
+		if meta then
+			if nodes[meta.__index] then
+				code[#code+1] = "setmetatable(%s,{__index=%s})"
+					%{ this, ref(meta.__index) }
+			else
+				unsafe = true
+			end
+		end
+
+		if unsafe then
+			code[#code+1] = this .. ".nosnapshot=true"
+		end
+		i = i + 1
+	end
+
+	for name, node in pairs(context.treecache) do
+		if ids[node] then
+			code[#code+1] = "c[%q]=%s" %{ name, ref(node) }
+		end
+	end
+
+	table.insert(code, 1,
+		"local r, c = ...\nlocal n = {}\nfor i = 1, %d do n[i] = {} end"
+		% #queue)
+	code[#code+1] = "return n[1]\n"
+
+	local tmp = file .. "." .. nixio.getpid()
+	local f = nixio.open(tmp, "w", 600)
+	if f then
+		f:writeall(util.get_bytecode(
+			assert(loadstring(table.concat(code, "\n")))))
+		f:close()
+		fs.rename(tmp, file)
+	end
+end
+
+--- Check whether a path only traverses nodes fully contained in a snapshot.
+-- @param tree	Dispatching tree
+-- @param path	Virtual path
+-- @return		Boolean
+function _snapshotcomplete(tree, path)
+	local c = tree
+	if c.nosnapshot then
+		return false
+	end
+
+	for _, s in ipairs(path) do
+		c = c.nodes and c.nodes[s]
+		if not c then
+			break
+		elseif c.nosnapshot then
+			return false
+		elseif c.leaf then
+			break
+		end
+	end
+
+	return true
+end
+
 --- Create the dispatching tree from the index.
--- Build the index before if it does not exist yet.
-function createtree()
+-- Build the index before if it does not exist yet. If a tree cache is
+-- configured, a current snapshot of the tree is loaded instead or a new
+-- snapshot is written once the tree is built.
+-- In lazy tree mode only the controllers contributing to the root level or
+-- to the top-level node of the requested path are executed, once the scopes
+-- of all controllers were recorded while building a full tree. The number
+-- of executed and skipped index functions is kept in context.treetrace.
+-- @param nosnapshot	Build the tree from the index in any case (optional)
+-- @return				Dispatching tree
+function createtree(nosnapshot)
+	local ctx  = context
+	local first = lazytree and (ctx.path[1] or "")
+	local snapfile = not nosnapshot and treecache
+		and treecache .. "." .. (i18n.context.lang or "")
+		.. (first and "." .. first or "")
+
+	if snapfile then
+		local tree = loadtree(snapfile)
+		if tree then
+			ctx.treetrace = {executed = 0, skipped = 0, snapshot = true}
+			return tree
+		end
+	end
+
 	if not index then
 		createindex()
 	end
 
-	local ctx  = context
-	local tree = {nodes={}, inreq=true}
+	-- long-lived processes keep the scopes across requests
+	if scopes and scopesdate <= _treedate() then
+		scopes = nil
+	end
+
+	if lazytree and not scopes then
+		scopes, scopesdate = _loadscopes()
+	end
+
+	first = scopes and first
+	recording = lazytree and not first and {}
+
+	local tree = {nodes={}, inreq=true, scope=first or nil, depends={}}
 	local modi = {}
+	local trace = {executed = 0, skipped = 0}
 
 	ctx.treecache = setmetatable({}, {__mode="v"})
 	ctx.tree = tree
 	ctx.modifiers = modi
+	ctx.treetrace = trace
 
 	-- Load default translation
 	require "luci.i18n".loadc("base")
@@ -581,9 +903,20 @@ function createtree()
 	local scope = setmetatable({}, {__index = luci.dispatcher})
 
 	for k, v in pairs(index) do
-		scope._NAME = k
-		setfenv(v, scope)
-		v()
+		local s = first and scopes[k]
+		if not first or s == nil or s == true or s[first] then
+			if recording then
+				recording[k] = {}
+			end
+
+			building = k
+			scope._NAME = k
+			setfenv(v, scope)
+			v()
+			trace.executed = trace.executed + 1
+		else
+			trace.skipped = trace.skipped + 1
+		end
 	end
 
 	local function modisort(a,b)
@@ -591,14 +924,40 @@ function createtree()
 	end
 
 	for _, v in util.spairs(modi, modisort) do
+		building = v.module
 		scope._NAME = v.module
 		setfenv(v.func, scope)
 		v.func()
 	end
 
+	building = nil
+
+	if recording then
+		scopes, scopesdate, recording = recording, os.time(), nil
+		if indexcache then
+			local f = nixio.open(indexcache .. ".scopes", "w", 600)
+			f:writeall(util.get_bytecode(scopes))
+			f:close()
+		end
+	end
+
+	if snapfile then
+		savetree(snapfile, tree)
+	end
+
 	return tree
 end
 
+--- Declare a file system path the index function depends on, e.g. if nodes
+-- are only registered if certain files are installed. Tree snapshots are
+-- discarded once the modification time of the path changes.
+-- @param	path	File system path
+function treedepend(path)
+	local mtime = fs.stat(path, "mtime") or 0
+	-- a change within the current second would go unnoticed
+	context.tree.depends[path] = mtime < os.time() and mtime or -1
+end
+
 --- Register a tree modifier.
 -- @param	func	Modifier function
 -- @param	order	Modifier order value (optional)
@@ -618,6 +977,8 @@ end
 -- @param	order	Destination node order value (optional)
 -- @return			Dispatching tree node
 function assign(path, clone, title, order)
+	_record(clone)
+
 	local obj  = node(unpack(path))
 	obj.nodes  = nil
 	obj.module = nil
@@ -652,6 +1013,7 @@ end
 -- @param	...		Virtual path
 -- @return			Dispatching tree node
 function get(...)
+	_record({...})
 	return _create_node({...})
 end
 
@@ -659,6 +1021,8 @@ end
 -- @param	...		Virtual path
 -- @return			Dispatching tree node
 function node(...)
+	_record({...})
+
 	local c = _create_node({...})
 
 	c.module = getfenv(2)._NAME
@@ -722,41 +1086,45 @@ function firstchild()
    return { type = "firstchild", target = _firstchild }
 end
 
+local function _alias(self, ...)
+	local req = { unpack(self.req) }
+	for _, r in ipairs({...}) do
+		req[#req+1] = r
+	end
+
+	dispatch(req)
+end
+
 --- Create a redirect to another dispatching node.
 -- @param	...		Virtual path destination
 function alias(...)
-	local req = {...}
-	return function(...)
-		for _, r in ipairs({...}) do
-			req[#req+1] = r
-		end
+	return {type = "alias", req = {...}, target = _alias}
+end
+
 
-		dispatch(req)
+local function _rewrite(self, ...)
+	local dispatched = util.clone(context.dispatched)
+
+	for i=1,self.n do
+		table.remove(dispatched, 1)
 	end
+
+	for i, r in ipairs(self.req) do
+		table.insert(dispatched, i, r)
+	end
+
+	for _, r in ipairs({...}) do
+		dispatched[#dispatched+1] = r
+	end
+
+	dispatch(dispatched)
 end
 
 --- Rewrite the first x path values of the request.
 -- @param	n		Number of path values to replace
 -- @param	...		Virtual path to replace removed path values with
 function rewrite(n, ...)
-	local req = {...}
-	return function(...)
-		local dispatched = util.clone(context.dispatched)
-
-		for i=1,n do
-			table.remove(dispatched, 1)
-		end
-
-		for i, r in ipairs(req) do
-			table.insert(dispatched, i, r)
-		end
-
-		for _, r in ipairs({...}) do
-			dispatched[#dispatched+1] = r
-		end
-
-		dispatch(dispatched)
-	end
+	return {type = "rewrite", n = n, req = {...}, target = _rewrite}
 end
 
 
@@ -946,6 +1314,12 @@ function form(model)
 	return {type = "cbi", model = model, target = _form}
 end
 
+snapshotrefs = {
+	_M = _M, _call = _call, _template = _template, _cbi = _cbi, _form = _form,
+	_arcombine = _arcombine, _firstchild = _firstchild,
+	_alias = _alias, _rewrite = _rewrite
+}
+
 --- Access the luci.i18n translate() api.
 -- @class  function
 -- @name   translate
@@ -27,6 +27,7 @@ limitations under the License.
 local ltn12 = require "luci.ltn12"
 local protocol = require "luci.http.protocol"
 local util  = require "luci.util"
+local tparser = require "luci.template.parser"
 local string = require "string"
 local coroutine = require "coroutine"
 local table = require "table"
@@ -126,6 +127,8 @@ end
 
 --- Close the HTTP-Connection.
 function close()
+	flush()
+
 	if not context.eoh then
 		context.eoh = true
 		coroutine.yield(3)
@@ -222,6 +225,37 @@ function status(code, message)
 	coroutine.yield(1, code, message)
 end
 
+--- Enable output buffering.
+-- Content passed to write() is collected and sent in chunks of the given
+-- size until the matching unbuffer() call. Calls may be nested.
+-- @param size	Buffer size (optional)
+-- @see unbuffer
+function buffer(size)
+	if not context.outbuf then
+		context.outbuf = tparser.buffer(size or 8192)
+	end
+	context.buffered = (context.buffered or 0) + 1
+end
+
+--- Leave output buffering and send out remaining buffered content
+-- when the outermost buffer() call is left.
+-- @see buffer
+function unbuffer()
+	context.buffered = (context.buffered or 1) - 1
+	if context.buffered <= 0 then
+		context.buffered = nil
+		flush()
+	end
+end
+
+--- Send out buffered content data.
+function flush()
+	local data = context.outbuf and context.outbuf:flush()
+	if data then
+		coroutine.yield(4, data)
+	end
+end
+
 --- Send a chunk of content data to the client.
 -- This function is as a valid LTN12 sink.
 -- If the content chunk is nil this function will automatically invoke close.
@@ -255,7 +289,13 @@ function write(content, src_err)
 			context.eoh = true
 			coroutine.yield(3)
 		end
-		coroutine.yield(4, content)
+		if context.buffered then
+			if context.outbuf:append(content) then
+				flush()
+			end
+		else
+			coroutine.yield(4, content)
+		end
 		return true
 	end
 end
@@ -264,6 +304,7 @@ end
 -- @param fp	File descriptor
 -- @param size	Bytes to splice (optional)
 function splice(fd, size)
+	flush()
 	coroutine.yield(6, fd, size)
 end
 
@@ -19,6 +19,7 @@ $Id$
 module("luci.http.protocol", package.seeall)
 
 local ltn12 = require("luci.ltn12")
+local nixio = require("nixio")
 
 HTTP_MAX_CONTENT      = 1024*8		-- 8 kB maximum content size
 
@@ -29,17 +30,8 @@ HTTP_MAX_CONTENT      = 1024*8		-- 8 kB maximum content size
 -- @return			The decoded string
 -- @see				urlencode
 function urldecode( str, no_plus )
-
-	local function __chrdec( hex )
-		return string.char( tonumber( hex, 16 ) )
-	end
-
 	if type(str) == "string" then
-		if not no_plus then
-			str = str:gsub( "+", " " )
-		end
-
-		str = str:gsub( "%%([a-fA-F0-9][a-fA-F0-9])", __chrdec )
+		str = nixio.bin.urldecode( str, no_plus )
 	end
 
 	return str
@@ -90,18 +82,8 @@ end
 -- @return		String containing the encoded data
 -- @see			urldecode
 function urlencode( str )
-
-	local function __chrenc( chr )
-		return string.format(
-			"%%%02x", string.byte( chr )
-		)
-	end
-
 	if type(str) == "string" then
-		str = str:gsub(
-			"([^a-zA-Z0-9$_%-%.%+!*'(),])",
-			__chrenc
-		)
+		str = nixio.bin.urlencode( str )
 	end
 
 	return str
@@ -330,28 +312,23 @@ function mimedecode_message_body( src, msg, filecb )
 
 
 	local tlen   = 0
-	local inhdr  = false
 	local field  = nil
 	local store  = nil
-	local lchunk = nil
+	local parser = nixio.multipart( msg.mime_boundary )
 
-	local function parse_headers( chunk, field )
+	-- Called by the parser for the header block and the data of each part
+	local function callback( event, data, eof )
+		if event == "header" then
+			field = { headers = { } }
 
-		local stat
-		repeat
-			chunk, stat = chunk:gsub(
-				"^([A-Z][A-Za-z0-9%-_]+): +([^\r\n]+)\r\n",
-				function(k,v)
-					field.headers[k] = v
-					return ""
+			for line in data:gmatch("(.-)\r\n") do
+				local k, v = line:match("^([A-Z][A-Za-z0-9%-_]+): +(.+)$")
+				if not k then
+					return nil, "Invalid MIME section header"
 				end
-			)
-		until stat == 0
-
-		chunk, stat = chunk:gsub("^\r\n","")
+				field.headers[k] = v
+			end
 
-		-- End of headers
-		if stat > 0 then
 			if field.headers["Content-Disposition"] then
 				if field.headers["Content-Disposition"]:match("^form%-data; ") then
 					field.name = field.headers["Content-Disposition"]:match('name="(.-)"')
@@ -378,10 +355,11 @@ function mimedecode_message_body( src, msg, filecb )
 				store = nil
 			end
 
-			return chunk, true
+		elseif store then
+			store( field, data, eof )
 		end
 
-		return chunk, false
+		return true
 	end
 
 	local function snk( chunk )
@@ -392,72 +370,7 @@ function mimedecode_message_body( src, msg, filecb )
 			return nil, "Message body size exceeds Content-Length"
 		end
 
-		if chunk and not lchunk then
-			lchunk = "\r\n" .. chunk
-
-		elseif lchunk then
-			local data = lchunk .. ( chunk or "" )
-			local spos, epos, found
-
-			repeat
-				spos, epos = data:find( "\r\n--" .. msg.mime_boundary .. "\r\n", 1, true )
-
-				if not spos then
-					spos, epos = data:find( "\r\n--" .. msg.mime_boundary .. "--\r\n", 1, true )
-				end
-
-
-				if spos then
-					local predata = data:sub( 1, spos - 1 )
-
-					if inhdr then
-						predata, eof = parse_headers( predata, field )
-
-						if not eof then
-							return nil, "Invalid MIME section header"
-						elseif not field.name then
-							return nil, "Invalid Content-Disposition header"
-						end
-					end
-
-					if store then
-						store( field, predata, true )
-					end
-
-
-					field = { headers = { } }
-					found = found or true
-
-					data, eof = parse_headers( data:sub( epos + 1, #data ), field )
-					inhdr = not eof
-				end
-			until not spos
-
-			if found then
-				if #data > 78 then
-					lchunk = data:sub( #data - 78 + 1, #data )
-					data   = data:sub( 1, #data - 78 )
-
-					if store then
-						store( field, data, false )
-					else
-						return nil, "Invalid MIME section header"
-					end
-				else
-					lchunk, data = data, nil
-				end
-			else
-				if inhdr then
-					lchunk, eof = parse_headers( data, field )
-					inhdr = not eof
-				else
-					store( field, lchunk, false )
-					lchunk, chunk = chunk, nil
-				end
-			end
-		end
-
-		return true
+		return parser:parse( chunk, callback )
 	end
 
 	return ltn12.pump.all( src, snk )
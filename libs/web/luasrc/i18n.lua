@@ -40,7 +40,8 @@ function clear()
 	table = {}
 end
 
---- Load a translation and copy its data into the translation table.
+--- Load a translation and merge its data into the translation table.
+-- Each language maps to a single lmo catalog which merges all loaded archives.
 -- @param file	Language file
 -- @param lang	Two-letter language code
 -- @param force	Force reload even if already loaded (optional)
@@ -51,19 +52,11 @@ function load(file, lang, force)
 		local f = lmo.open(i18ndir .. file .. "." .. lang .. ".lmo")
 		if f then
 			if not table[lang] then
-				table[lang] = { f }
-				setmetatable(table[lang], {
-					__index = function(tbl, key)
-						for i = 1, #tbl do
-							local s = rawget(tbl, i):lookup(key)
-							if s then return s end
-						end
-					end
-				})
-			else
-				table[lang][#table[lang]+1] = f
+				table[lang] = lmo.catalog()
 			end
 
+			table[lang]:add(f)
+
 			loaded[lang] = loaded[lang] or {}
 			loaded[lang][file] = true
 			return true
@@ -96,10 +89,8 @@ end
 -- @param key	Default translation text
 -- @return		Translated string
 function translate(key)
-	return (table[context.lang] and table[context.lang][key])
-		or (table[context.parent] and table[context.parent][key])
-		or (table[default] and table[default][key])
-		or key
+	return lmo.lookup(key, table[context.lang], table[context.parent],
+		table[default]) or key
 end
 
 --- Return the translated value for a specific translation key and use it as sprintf pattern.
@@ -26,9 +26,118 @@ luci.config.sauth = luci.config.sauth or {}
 sessionpath = luci.config.sauth.sessionpath
 sessiontime = tonumber(luci.config.sauth.sessiontime) or 15 * 60
 
+-- Storage backend: "file" (one file per session) or "table" (a single file
+-- of fixed-size slots inside the session directory)
+backend = luci.config.sauth.backend or "file"
+sessionslots = math.max(tonumber(luci.config.sauth.sessionslots) or 128, 8)
+
+-- Session table layout: each slot holds a header (id, mtime, data length)
+-- followed by the data. A session may be stored in one of PROBES slots
+-- following the slot selected by the hash of its id.
+local SLOTSIZE = 1024
+local SLOTHDR  = "%-64s%12d%8d"
+local HDRSIZE  = 84
+local PROBES   = 8	-- must not exceed the minimum number of slots
+
+-- Open and lock the session table. It lives inside the private session
+-- directory so it cannot be replaced by a link to some other file.
+local function tbl_open()
+	if not sane() then
+		prepare()
+	end
+
+	local f = nixio.open(sessionpath .. "/.table",
+		nixio.open_flags("rdwr", "creat"), 600)
+
+	if not f then
+		return nil
+	end
+
+	local stat = f:stat()
+	if stat.uid ~= luci.sys.process.info("uid")
+	or stat.modestr ~= "rw-------" then
+		f:close()
+		error("Security Exception: Session table is not sane!")
+	end
+
+	f:lock("lock")
+	return f
+end
+
+-- Parse a slot, returns id, mtime and data of an unexpired session.
+local function tbl_parse(slot, now)
+	local id = slot:sub(1, 64):match("^%w+")
+	local mtime = tonumber(slot:sub(65, 76))
+	local len = tonumber(slot:sub(77, HDRSIZE))
+
+	if id and mtime and len and mtime + sessiontime >= now then
+		return id, mtime, slot:sub(HDRSIZE + 1, HDRSIZE + len)
+	end
+end
+
+-- Clear a slot including the data of the session it held.
+local function tbl_clear(f, slot)
+	f:seek(slot * SLOTSIZE)
+	f:writeall(SLOTHDR:format("", 0, 0) .. ("\0"):rep(SLOTSIZE - HDRSIZE))
+end
+
+-- Update the modification time of a slot.
+local function tbl_touch(f, slot, time)
+	f:seek(slot * SLOTSIZE + 64)
+	f:writeall(("%12d"):format(time))
+end
+
+-- Locate a session, returns its slot and data, lazily removing it if it
+-- expired, and a free or the least recently used slot for writing.
+local function tbl_find(f, id)
+	local first = nixio.bin.crc32(id) % (sessionslots - PROBES + 1)
+	local now = os.time()
+	local free, lru, lrutime
+
+	f:seek(first * SLOTSIZE)
+	local block = f:readall(PROBES * SLOTSIZE) or ""
+
+	for i = 0, PROBES - 1 do
+		local slot = block:sub(i * SLOTSIZE + 1, (i + 1) * SLOTSIZE)
+		local sid, mtime, data = tbl_parse(slot, now)
+
+		if sid == id then
+			return first + i, data
+		elseif not sid then
+			if slot:sub(1, 64):match("^%w+") == id then
+				tbl_clear(f, first + i)
+			end
+			free = free or first + i
+		elseif not lrutime or mtime < lrutime then
+			lru, lrutime = first + i, mtime
+		end
+	end
+
+	return nil, nil, free or lru
+end
+
 --- Manually clean up expired sessions.
 function clean()
 	local now   = os.time()
+
+	if backend == "table" then
+		local f = tbl_open()
+		if not f then
+			return nil
+		end
+
+		local data = f:readall()
+		for i = 0, #data / SLOTSIZE - 1 do
+			local slot = data:sub(i * SLOTSIZE + 1, (i + 1) * SLOTSIZE)
+			if slot:match("^%w") and not tbl_parse(slot, now) then
+				tbl_clear(f, i)
+			end
+		end
+
+		f:close()
+		return
+	end
+
 	local files = fs.dir(sessionpath)
 	
 	if not files then
@@ -63,6 +172,22 @@ function read(id)
 	if not id:match("^%w+$") then
 		error("Session ID is not sane!")
 	end
+
+	if backend == "table" then
+		local f = tbl_open()
+		if not f then
+			return
+		end
+
+		local slot, data = tbl_find(f, id)
+		if slot then
+			tbl_touch(f, slot, os.time())
+		end
+
+		f:close()
+		return data
+	end
+
 	clean()
 	if not sane(sessionpath .. "/" .. id) then
 		return
@@ -86,12 +211,30 @@ end
 -- @param id	Session identifier
 -- @param data	Session data
 function write(id, data)
-	if not sane() then
-		prepare()
-	end
 	if not id:match("^%w+$") then
 		error("Session ID is not sane!")
 	end
+
+	if backend == "table" then
+		if #id > 64 or #data > SLOTSIZE - HDRSIZE then
+			error("Session data exceeds the session table slot size!")
+		end
+
+		-- sessions are only written on login, sweep the table on this occasion
+		clean()
+
+		local f = assert(tbl_open(), "Unable to open the session table!")
+		local slot, _, free = tbl_find(f, id)
+
+		f:seek((slot or free) * SLOTSIZE)
+		f:writeall(SLOTHDR:format(id, os.time(), #data) .. data)
+		f:close()
+		return
+	end
+
+	if not sane() then
+		prepare()
+	end
 	
 	local f = nixio.open(sessionpath .. "/" .. id, "w", 600)
 	f:writeall(data)
@@ -99,11 +242,53 @@ function write(id, data)
 end
 
 
+--- Update the modification time of a session.
+-- Keeps a session alive, e.g. across a change of the system clock.
+-- @param id	Session identifier
+-- @param time	New modification time (optional, default: current time)
+function touch(id, time)
+	if not id:match("^%w+$") then
+		error("Session ID is not sane!")
+	end
+
+	time = time or os.time()
+
+	if backend == "table" then
+		local f = tbl_open()
+		if f then
+			local slot = tbl_find(f, id)
+			if slot then
+				tbl_touch(f, slot, time)
+			end
+			f:close()
+		end
+		return
+	end
+
+	if sane(sessionpath .. "/" .. id) then
+		fs.utimes(sessionpath .. "/" .. id, time, time)
+	end
+end
+
+
 --- Kills a session
 -- @param id	Session identifier
 function kill(id)
 	if not id:match("^%w+$") then
 		error("Session ID is not sane!")
 	end
+
+	if backend == "table" then
+		local f = tbl_open()
+		if f then
+			local slot = tbl_find(f, id)
+			if slot then
+				tbl_clear(f, slot)
+			end
+			f:close()
+		end
+		return
+	end
+
 	fs.unlink(sessionpath .. "/" .. id)
 end
@@ -24,8 +24,12 @@ limitations under the License.
 
 ]]--
 
+local io = require "io"
+local fs = require "nixio.fs"
+local nixio = require "nixio"
 local util = require "luci.util"
 local config = require "luci.config"
+local http = require "luci.http"
 local tparser = require "luci.template.parser"
 
 local tostring, pairs, loadstring = tostring, pairs, loadstring
@@ -39,6 +43,12 @@ module "luci.template"
 config.template = config.template or {}
 viewdir = config.template.viewdir or util.libpath() .. "/view"
 
+-- Compiled templates are looked up in the read-only precompiled store first
+-- and then in the runtime cache which is filled on demand.
+precompdir = config.template.precompdir or util.libpath() .. "/view-cache"
+cachedir = config.template.cachedir or "/tmp/luci-templatecache"
+cachemode = "r--r--r--"
+
 
 -- Define the namespace for template modules
 context = util.threadlocal()
@@ -51,6 +61,93 @@ function render(name, scope)
 end
 
 
+--- Return the file name of a compiled template within a cache directory.
+-- The name is derived from the template name and the modification time and
+-- size of its source, so a changed source never matches a stale entry.
+-- @param dir		Cache directory
+-- @param name		Template name
+-- @param stat		Stat table of the template source
+-- @return			Path of the compiled template
+function cachefile(dir, name, stat)
+	return ("%s/%s-%x-%x"):format(dir, nixio.bin.hexlify(name),
+		stat.mtime, stat.size)
+end
+
+--- Compile a template and store its bytecode in the given directory.
+-- @param name		Template name
+-- @param dir		Target directory (optional, defaults to the runtime cache)
+-- @param strip		Strip debug information from the bytecode (optional)
+-- @return			Compiled template function or nil and an error message
+function compile(name, dir, strip)
+	local sourcefile = viewdir .. "/" .. name .. ".htm"
+	local stat = fs.stat(sourcefile)
+	local func, _, err = tparser.parse(sourcefile)
+
+	if func and stat then
+		dir = dir or cachedir
+
+		if not fs.stat(dir) then
+			fs.mkdirr(dir)
+		end
+
+		local file = cachefile(dir, name, stat)
+		local temp = file .. "." .. nixio.getpid()
+		local fp = io.open(temp, "w")
+		if fp then
+			local code = util.get_bytecode(func)
+			fp:write(strip and util.strip_bytecode(code) or code)
+			fp:close()
+			fs.chmod(temp, cachemode)
+			fs.rename(temp, file)
+		end
+	end
+
+	return func, err
+end
+
+--- Compile all templates below the view directory into the given directory.
+-- @param dir		Target directory (optional, defaults to the precompiled store)
+-- @param strip		Strip debug information from the bytecode (optional)
+-- @return			Number of compiled templates and table of failed names
+function compileall(dir, strip)
+	local count, failed = 0, { }
+
+	local function scan(path)
+		for e in (fs.dir(viewdir .. path) or function() end) do
+			local rel = path .. "/" .. e
+			local stat = fs.stat(viewdir .. rel)
+			if stat and stat.type == "dir" then
+				scan(rel)
+			elseif e:match("%.htm$") then
+				local name = rel:sub(2, -5)
+				if compile(name, dir or precompdir, strip) then
+					count = count + 1
+				else
+					failed[#failed+1] = name
+				end
+			end
+		end
+	end
+
+	scan("")
+	return count, failed
+end
+
+-- Load a compiled template from the precompiled store or the runtime cache
+local function loadcached(name, stat)
+	local func = loadfile(cachefile(precompdir, name, stat))
+	if func then
+		return func
+	end
+
+	local file = cachefile(cachedir, name, stat)
+	local cstat = fs.stat(file)
+	if cstat and cstat.uid == nixio.getuid() and cstat.modestr == cachemode then
+		return loadfile(file)
+	end
+end
+
+
 -- Template class
 Template = util.class()
 
@@ -70,18 +167,22 @@ function Template.__init__(self, name)
 	-- If we have a cached template, skip compiling and loading
 	if not self.template then
 
-		-- Compile template
+		-- Load compiled template or compile and store it
 		local err
 		local sourcefile = viewdir .. "/" .. name .. ".htm"
+		local stat = fs.stat(sourcefile)
 
-		self.template, _, err = tparser.parse(sourcefile)
+		self.template = stat and loadcached(name, stat)
+
+		if not self.template then
+			self.template, err = compile(name)
+		end
 
 		-- If we have no valid template throw error, otherwise cache the template
 		if not self.template then
 			error("Failed to load template '" .. name .. "'.\n" ..
 			      "Error while parsing template '" .. sourcefile .. "'.\n" ..
-			      "A syntax error occured near '" ..
-			      (err or "(nil)"):gsub("\t", "\\t"):gsub("\n", "\\n") .. "'.")
+			      "A syntax error occured: " .. tostring(err or "(nil)"))
 		else
 			self.cache[name] = self.template
 		end
@@ -99,8 +200,11 @@ function Template.render(self, scope)
 			return rawget(tbl, key) or self.viewns[key] or scope[key]
 		end}))
 	
-	-- Now finally render the thing
+	-- Now finally render the thing, collecting the output of the individual
+	-- write() calls into larger chunks
+	http.buffer()
 	local stat, err = util.copcall(self.template)
+	http.unbuffer()
 	if not stat then
 		error("Failed to execute template '" .. self.name .. "'.\n" ..
 		      "A runtime error occured: " .. tostring(err or "(nil)"))
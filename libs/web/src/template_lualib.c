@@ -21,18 +21,14 @@
 int template_L_parse(lua_State *L)
 {
 	const char *file = luaL_checkstring(L, 1);
-	struct template_parser parser;
+	struct template_parser *parser = template_open(file);
 	int lua_status;
 
-	if( (parser.fd = open(file, O_RDONLY)) > 0 )
+	if( parser != NULL )
 	{
-		parser.flags   = 0;
-		parser.bufsize = 0;
-		parser.state   = T_STATE_TEXT_NEXT;
+		lua_status = lua_load(L, template_reader, parser, file);
 
-		lua_status = lua_load(L, template_reader, &parser, file);
-
-		(void) close(parser.fd);
+		template_close(parser);
 
 
 		if( lua_status == 0 )
@@ -43,7 +39,7 @@ int template_L_parse(lua_State *L)
 		{
 			lua_pushnil(L);
 			lua_pushinteger(L, lua_status);
-			lua_pushlstring(L, parser.out, parser.outsize);
+			lua_pushvalue(L, -3);
 			return 3;
 		}
 	}
@@ -58,9 +54,16 @@ int template_L_sanitize_utf8(lua_State *L)
 {
 	size_t len = 0;
 	const char *str = luaL_checklstring(L, 1, &len);
-	char *res = sanitize_utf8(str, len);
+	char *res;
 
-	if (res != NULL)
+	/* return clean strings as-is, avoids copying and interning */
+	if (sanitize_utf8_clean(str, len))
+	{
+		lua_pushvalue(L, 1);
+		return 1;
+	}
+
+	if ((res = sanitize_utf8(str, len)) != NULL)
 	{
 		lua_pushstring(L, res);
 		free(res);
@@ -75,9 +78,16 @@ int template_L_sanitize_pcdata(lua_State *L)
 {
 	size_t len = 0;
 	const char *str = luaL_checklstring(L, 1, &len);
-	char *res = sanitize_pcdata(str, len);
+	char *res;
+
+	/* return clean strings as-is, avoids copying and interning */
+	if (sanitize_pcdata_clean(str, len))
+	{
+		lua_pushvalue(L, 1);
+		return 1;
+	}
 
-	if (res != NULL)
+	if ((res = sanitize_pcdata(str, len)) != NULL)
 	{
 		lua_pushstring(L, res);
 		free(res);
@@ -88,16 +98,108 @@ int template_L_sanitize_pcdata(lua_State *L)
 	return 0;
 }
 
+/*
+ * Output buffer, collects template output in C memory. append() reports
+ * when the fill level reached the limit so the caller can flush() it.
+ */
+int template_L_buffer(lua_State *L)
+{
+	int limit = luaL_optint(L, 1, 8192);
+	struct template_luabuffer *lb;
+
+	luaL_argcheck(L, limit > 0, 1, "invalid limit");
+
+	lb = lua_newuserdata(L, sizeof(struct template_luabuffer));
+	lb->limit = limit;
+
+	if( (lb->buf = buf_init(limit + 1)) == NULL )
+		return luaL_error(L, "out of memory");
+
+	luaL_getmetatable(L, TEMPLATE_BUFFER_META);
+	lua_setmetatable(L, -2);
+
+	return 1;
+}
+
+int template_L_buffer_append(lua_State *L)
+{
+	struct template_luabuffer *lb = luaL_checkudata(L, 1, TEMPLATE_BUFFER_META);
+	size_t len = 0;
+	const char *str = luaL_checklstring(L, 2, &len);
+
+	if( (len > 0) && !buf_append(lb->buf, (const unsigned char *)str, len) )
+		return luaL_error(L, "out of memory");
+
+	lua_pushboolean(L, buf_length(lb->buf) >= lb->limit);
+	return 1;
+}
+
+int template_L_buffer_flush(lua_State *L)
+{
+	struct template_luabuffer *lb = luaL_checkudata(L, 1, TEMPLATE_BUFFER_META);
+
+	if( buf_length(lb->buf) > 0 )
+	{
+		lua_pushlstring(L, (const char *)lb->buf->data, buf_length(lb->buf));
+
+		lb->buf->fill = 0;
+		lb->buf->dptr = lb->buf->data;
+		lb->buf->data[0] = 0;
+	}
+	else
+	{
+		lua_pushnil(L);
+	}
+
+	return 1;
+}
+
+int template_L_buffer__len(lua_State *L)
+{
+	struct template_luabuffer *lb = luaL_checkudata(L, 1, TEMPLATE_BUFFER_META);
+	lua_pushinteger(L, buf_length(lb->buf));
+	return 1;
+}
+
+int template_L_buffer__gc(lua_State *L)
+{
+	struct template_luabuffer *lb = luaL_checkudata(L, 1, TEMPLATE_BUFFER_META);
+
+	if( lb->buf != NULL )
+		free(buf_destroy(lb->buf));
+
+	lb->buf = NULL;
+
+	return 0;
+}
+
+
+/* buffer method table */
+static const luaL_reg B[] = {
+	{ "append",				template_L_buffer_append },
+	{ "flush",				template_L_buffer_flush },
+	{ "__len",				template_L_buffer__len },
+	{ "__gc",				template_L_buffer__gc },
+	{ NULL,					NULL }
+};
 
 /* module table */
 static const luaL_reg R[] = {
 	{ "parse",				template_L_parse },
+	{ "buffer",				template_L_buffer },
 	{ "sanitize_utf8",		template_L_sanitize_utf8 },
 	{ "sanitize_pcdata",	template_L_sanitize_pcdata },
+	{ "pcdata",				template_L_sanitize_pcdata },
 	{ NULL,					NULL }
 };
 
 LUALIB_API int luaopen_luci_template_parser(lua_State *L) {
+	luaL_newmetatable(L, TEMPLATE_BUFFER_META);
+	luaL_register(L, NULL, B);
+	lua_pushvalue(L, -1);
+	lua_setfield(L, -2, "__index");
+	lua_pop(L, 1);
+
 	luaL_register(L, TEMPLATE_LUALIB_META, R);
 	return 1;
 }
@@ -23,6 +23,13 @@
 #include "template_utils.h"
 
 #define TEMPLATE_LUALIB_META  "template.parser"
+#define TEMPLATE_BUFFER_META  "template.buffer"
+
+/* output buffer object */
+struct template_luabuffer {
+	struct template_buffer *buf;
+	unsigned int limit;
+};
 
 LUALIB_API int luaopen_luci_template_parser(lua_State *L);
 
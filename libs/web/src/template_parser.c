@@ -30,436 +30,342 @@ const char * gen_code[7][2] = {
 	{ NULL,					" "				}
 };
 
-/* Simple strstr() like function that takes len arguments for both haystack and needle. */
-static char *strfind(char *haystack, int hslen, const char *needle, int ndlen)
+/* Find the next occurence of the two byte token tok within s..e */
+static const char * tokfind(const char *s, const char *e, const char *tok)
 {
-	int match = 0;
-	int i, j;
-
-	for( i = 0; i < hslen; i++ )
+	while( (s < e) && ((s = memchr(s, tok[0], e - s)) != NULL) )
 	{
-		if( haystack[i] == needle[0] )
-		{
-			match = ((ndlen == 1) || ((i + ndlen) <= hslen));
+		if( ((s + 1) < e) && (s[1] == tok[1]) )
+			return s;
 
-			for( j = 1; (j < ndlen) && ((i + j) < hslen); j++ )
-			{
-				if( haystack[i+j] != needle[j] )
-				{
-					match = 0;
-					break;
-				}
-			}
-
-			if( match )
-				return &haystack[i];
-		}
+		s++;
 	}
 
 	return NULL;
 }
 
-/*
- * Inspect current read buffer and find the number of "vague" characters at the end
- * which could indicate an opening token. Returns the number of "vague" chars.
- * The last continuous sequence of whitespace, optionally followed by a "<" is
- * treated as "vague" because whitespace may be discarded if the upcoming opening
- * token indicates pre-whitespace-removal ("<%-"). A single remaining "<" char
- * can't be differentiated from an opening token ("<%"), so it's kept to be processed
- * in the next cycle.
- */
-static int stokscan(struct template_parser *data, int off, int no_whitespace)
+/* Append len bytes to the output buffer, empty input is not an error */
+static int bufadd(struct template_buffer *out, const char *s, int len)
+{
+	return (len <= 0) || buf_append(out, (const unsigned char *)s, len);
+}
+
+/* Count the newlines within s..e */
+static int lines(const char *s, const char *e)
 {
-	int i;
-	int skip = 0;
-	int tokoff = data->bufsize - 1;
+	int n = 0;
 
-	for( i = tokoff; i >= off; i-- )
+	while( (s < e) && ((s = memchr(s, '\n', e - s)) != NULL) )
 	{
-		if( data->buf[i] == T_TOK_START[0] )
-		{
-			skip = tokoff - i + 1;
-			tokoff = i - 1;
-			break;
-		}
+		n++;
+		s++;
 	}
 
-	if( !no_whitespace )
+	return n;
+}
+
+/*
+ * Append the string s..e escaped for use within a double quoted Lua string.
+ * Runs of unescaped chars are copied in one go.
+ */
+static int escape(struct template_buffer *out, const char *s, const char *e)
+{
+	const char *run = s;
+	const char *esc;
+
+	for( ; s < e; s++ )
 	{
-		for( i = tokoff; i >= off; i-- )
+		switch(*s)
 		{
-			if( isspace(data->buf[i]) )
-				skip++;
-			else
-				break;
+			case '\\': esc = "\\\\"; break;
+			case '"':  esc = "\\\""; break;
+			case '\n': esc = "\\n";  break;
+			case '\t': esc = "\\t";  break;
+			case '\r': esc = "\\r";  break;
+			default:   continue;
 		}
+
+		if( !bufadd(out, run, s - run) || !bufadd(out, esc, 2) )
+			return 0;
+
+		run = s + 1;
 	}
 
-	return skip;
+	return bufadd(out, run, e - run);
 }
 
 /*
- * Similar to stokscan() but looking for closing token indicators.
- * Matches "-", optionally followed by a "%" char.
+ * Append the i18n key s..e, surrounding whitespace is removed and inner
+ * whitespace runs are collapsed into a single space.
  */
-static int etokscan(struct template_parser *data)
+static int escape_i18n(struct template_buffer *out, const char *s, const char *e)
 {
-	int skip = 0;
+	int ws = 0;
+
+	while( (s < e) && isspace((unsigned char)*s) )
+		s++;
+
+	while( (e > s) && isspace((unsigned char)*(e-1)) )
+		e--;
+
+	for( ; s < e; s++ )
+	{
+		if( isspace((unsigned char)*s) )
+		{
+			if( !ws && !buf_putchar(out, ' ') )
+				return 0;
 
-	if( (data->bufsize > 0) && (data->buf[data->bufsize-1] == T_TOK_END[0]) )
-		skip++;
+			ws = 1;
+			continue;
+		}
 
-	if( (data->bufsize > skip) && (data->buf[data->bufsize-skip-1] == T_TOK_SKIPWS[0]) )
-		skip++;
+		if( ((*s == '\\') || (*s == '"')) && !buf_putchar(out, '\\') )
+			return 0;
 
-	return skip;
+		if( !buf_putchar(out, *s) )
+			return 0;
+
+		ws = 0;
+	}
+
+	return 1;
 }
 
 /*
- * Generate Lua expressions from the given raw code, write it into the
- * output buffer and set the lua_Reader specific size pointer.
- * Takes parser-state, lua_Reader's size pointer and generator flags
- * as parameter. The given flags indicate whether leading or trailing
- * code should be added. Returns a pointer to the output buffer.
+ * Generate the Lua expression for the given chunk and append it to the
+ * output buffer. The given flags indicate whether leading or trailing code
+ * should be added. Newlines which end up escaped in the generated code are
+ * emitted in front of the expression, so line numbers reported by the Lua
+ * compiler match the template source.
  */
-static const char * generate_expression(struct template_parser *data, size_t *sz, int what)
+static int generate_expression(struct template_buffer *out, int type,
+                               const char *s, const char *e, int what)
 {
-	char tmp[T_OUTBUFSZ];
-	int i;
-	int size = 0;
-	int start = 0;
-	int whitespace = 0;
+	int i, n;
 
-	memset(tmp, 0, T_OUTBUFSZ);
+	/* Keep line numbers in sync for chunks not copied verbatim */
+	if( (type != T_TYPE_EXPR) && (type != T_TYPE_CODE) )
+		for( i = 0, n = lines(s, e); i < n; i++ )
+			if( !buf_putchar(out, '\n') )
+				return 0;
 
 	/* Inject leading expression code (if any) */
-	if( (what & T_GEN_START) && (gen_code[data->type][0] != NULL) )
+	if( (what & T_GEN_START) && (gen_code[type][0] != NULL) )
+		if( !bufadd(out, gen_code[type][0], strlen(gen_code[type][0])) )
+			return 0;
+
+	switch(type)
 	{
-		memcpy(tmp, gen_code[data->type][0], strlen(gen_code[data->type][0]));
-		size += strlen(gen_code[data->type][0]);
+		case T_TYPE_COMMENT:
+			break;
+
+		case T_TYPE_INCLUDE:
+			/* Skip leading whitespace */
+			while( (s < e) && isspace((unsigned char)*s) )
+				s++;
+
+			/* fall through */
+
+		case T_TYPE_TEXT:
+			if( !escape(out, s, e) )
+				return 0;
+
+			break;
+
+		case T_TYPE_I18N:
+		case T_TYPE_I18N_RAW:
+			if( !escape_i18n(out, s, e) )
+				return 0;
+
+			break;
+
+		default:
+			if( !bufadd(out, s, e - s) )
+				return 0;
+
+			break;
 	}
 
-	/* Parse source buffer */
-	for( i = 0; i < data->outsize; i++ )
+	/* Inject trailing expression code (if any) */
+	if( (what & T_GEN_END) && (gen_code[type][1] != NULL) )
+		if( !bufadd(out, gen_code[type][1], strlen(gen_code[type][1])) )
+			return 0;
+
+	return 1;
+}
+
+/*
+ * Translate the whole mapped template into Lua code within a single pass.
+ * Returns 0 if the output buffer could not be grown.
+ */
+static int template_generate(struct template_parser *parser)
+{
+	const char *p   = parser->mmap;
+	const char *end = parser->mmap + parser->size;
+	const char *ts, *te, *tag, *cs, *ce;
+	int skipws = 0;
+	int type;
+
+	while( p < end )
 	{
-		/* Skip leading whitespace for non-raw and non-expr chunks */
-		if( !start && isspace(data->out[i]) && (data->type == T_TYPE_I18N ||
-           data->type == T_TYPE_I18N_RAW || data->type == T_TYPE_INCLUDE) )
-			continue;
-		else if( !start )
-			start = 1;
+		/* Plain text chunk (before "<%") */
+		ts  = p;
+		tag = tokfind(p, end, T_TOK_START);
+		te  = tag ? tag : end;
+
+		/* Skip leading whitespace if requested by a preceding "-%>" */
+		if( skipws )
+			while( (ts < te) && isspace((unsigned char)*ts) )
+				ts++;
+
+		skipws = 0;
+
+		/* Strip trailing whitespace if followed by "<%-", like previous
+		 * versions a whitespace only chunk retains its first char */
+		if( tag && ((tag + 2) < end) && (tag[2] == T_TOK_SKIPWS[0]) )
+			while( (te > (ts + 1)) && isspace((unsigned char)*(te-1)) )
+				te--;
+
+		if( (te > ts) &&
+		    !generate_expression(parser->out, T_TYPE_TEXT, ts, te,
+		                         T_GEN_START | T_GEN_END) )
+			return 0;
+
+		if( tag == NULL )
+			break;
 
-		/* Found whitespace after i18n key */
-		if( data->type == T_TYPE_I18N || data->type == T_TYPE_I18N_RAW )
-		{
-			/* Is initial whitespace, insert space */
-			if( !whitespace && isspace(data->out[i]) )
-			{
-				tmp[size++] = ' ';
-				whitespace = 1;
-			}
+		/* Code chunk ("<% ... %>"), skip optional leading '-' */
+		cs = tag + strlen(T_TOK_START);
 
-			/* Suppress subsequent whitespace, escape special chars */
-			else if( !isspace(data->out[i]) )
-			{
-				if( data->out[i] == '\\' || data->out[i] == '"' )
-					tmp[size++] = '\\';
+		if( (cs < end) && (*cs == T_TOK_SKIPWS[0]) )
+			cs++;
 
-				tmp[size++] = data->out[i];
-				whitespace = 0;
-			}
-		}
+		if( (cs < end) && (*cs == T_TOK_SKIPWS[0]) )
+			cs++;
 
-		/* Escape quotes, backslashes and newlines for plain and include expressions */
-		else if( (data->type == T_TYPE_TEXT || data->type == T_TYPE_INCLUDE) &&
-		    (data->out[i] == '\\' || data->out[i] == '"' || data->out[i] == '\n' || data->out[i] == '\t') )
-		{
-			tmp[size++] = '\\';
+		/* Determine code type */
+		type = T_TYPE_CODE;
 
-			switch(data->out[i])
+		if( cs < end )
+		{
+			switch(*cs)
 			{
-				case '\n':
-					tmp[size++] = 'n';
-					break;
+				case '#': type = T_TYPE_COMMENT;  cs++; break;
+				case '=': type = T_TYPE_EXPR;     cs++; break;
+				case '+': type = T_TYPE_INCLUDE;  cs++; break;
+				case ':': type = T_TYPE_I18N;     cs++; break;
+				case '_': type = T_TYPE_I18N_RAW; cs++; break;
+			}
+		}
 
-				case '\t':
-					tmp[size++] = 't';
-					break;
+		/* Unterminated chunk, emit what we have and let Lua complain */
+		if( (ce = tokfind(cs, end, T_TOK_END)) == NULL )
+		{
+			if( (type != T_TYPE_COMMENT) &&
+			    !generate_expression(parser->out, type, cs, end, T_GEN_START) )
+				return 0;
 
-				default:
-					tmp[size++] = data->out[i];
-			}
+			break;
 		}
 
-		/* Normal char */
-		else
+		p = ce + strlen(T_TOK_END);
+
+		/* Check for trailing '-' */
+		if( (ce > cs) && (*(ce-1) == T_TOK_SKIPWS[0]) )
 		{
-			tmp[size++] = data->out[i];
+			ce--;
+			skipws = 1;
 		}
+
+		if( !generate_expression(parser->out, type, cs, ce,
+		                         T_GEN_START | T_GEN_END) )
+			return 0;
 	}
 
-	/* Inject trailing expression code (if any) */
-	if( (what & T_GEN_END) && (gen_code[data->type][1] != NULL) )
+	return 1;
+}
+
+/*
+ * Open and map the given template file and translate it into Lua code.
+ */
+struct template_parser * template_open(const char *file)
+{
+	struct stat s;
+	struct template_parser *parser;
+
+	if( !(parser = malloc(sizeof(*parser))) )
+		goto err;
+
+	memset(parser, 0, sizeof(*parser));
+	parser->fd = -1;
+
+	if( (parser->fd = open(file, O_RDONLY)) < 0 )
+		goto err;
+
+	if( fstat(parser->fd, &s) )
+		goto err;
+
+	parser->size = s.st_size;
+
+	if( parser->size > 0 )
 	{
-		/* Strip trailing space for i18n expressions */
-		if( data->type == T_TYPE_I18N || data->type == T_TYPE_I18N_RAW )
-			if( (size > 0) && (tmp[size-1] == ' ') )
-				size--;
+		parser->mmap = mmap(NULL, parser->size, PROT_READ, MAP_PRIVATE,
+		                    parser->fd, 0);
 
-		memcpy(&tmp[size], gen_code[data->type][1], strlen(gen_code[data->type][1]));
-		size += strlen(gen_code[data->type][1]);
+		if( parser->mmap == MAP_FAILED )
+		{
+			parser->mmap = NULL;
+			goto err;
+		}
 	}
 
-	*sz = data->outsize = size;
-	memset(data->out, 0, T_OUTBUFSZ);
-	memcpy(data->out, tmp, size);
+	/* generated code is usually a bit larger than the source */
+	if( !(parser->out = buf_init(parser->size + (parser->size / 4) + 64)) )
+		goto err;
+
+	if( !template_generate(parser) )
+		goto err;
 
-	//printf("<<<%i|%i|%i|%s>>>\n", what, data->type, *sz, data->out);
+	return parser;
 
-	return data->out;
+err:
+	template_close(parser);
+	return NULL;
 }
 
-/*
- * Move the number of bytes specified in data->bufsize from the
- * given source pointer to the beginning of the read buffer.
- */
-static void bufmove(struct template_parser *data, const char *src)
+void template_close(struct template_parser *parser)
 {
-	if( data->bufsize > 0 )
-		memmove(data->buf, src, data->bufsize);
-	else if( data->bufsize < 0 )
-		data->bufsize = 0;
+	if( !parser )
+		return;
 
-	data->buf[data->bufsize] = 0;
-}
+	if( parser->out )
+		free(buf_destroy(parser->out));
 
-/*
- * Move the given amount of bytes from the given source pointer
- * to the output buffer and set data->outputsize.
- */
-static void bufout(struct template_parser *data, const char *src, int len)
-{
-	if( len >= 0 )
-	{
-		memset(data->out, 0, T_OUTBUFSZ);
-		memcpy(data->out, src, len);
-		data->outsize = len;
-	}
-	else
-	{
-		data->outsize = 0;
-	}
+	if( parser->mmap )
+		munmap(parser->mmap, parser->size);
+
+	if( parser->fd >= 0 )
+		close(parser->fd);
+
+	free(parser);
 }
 
 /*
- * lua_Reader compatible function that parses template code on demand from
- * the given file handle.
+ * lua_Reader compatible function that hands the generated code to Lua
+ * in one slice.
  */
 const char *template_reader(lua_State *L, void *ud, size_t *sz)
 {
-	struct template_parser *data = ud;
-	char *match = NULL;
-	int off = 0;
-	int ignore = 0;
-	int genflags = 0;
-	int readlen = 0;
-	int vague = 0;
-
-	while( !(data->flags & T_FLAG_EOF) || (data->bufsize > 0) )
-	{
-		/* Fill buffer */
-		if( !(data->flags & T_FLAG_EOF) && (data->bufsize < T_READBUFSZ) )
-		{
-			if( (readlen = read(data->fd, &data->buf[data->bufsize], T_READBUFSZ - data->bufsize)) > 0 )
-				data->bufsize += readlen;
-			else if( readlen == 0 )
-				data->flags |= T_FLAG_EOF;
-			else
-				return NULL;
-		}
+	struct template_parser *parser = ud;
 
-		/* Evaluate state */
-		switch(data->state)
-		{
-			/* Plain text chunk (before "<%") */
-			case T_STATE_TEXT_INIT:
-			case T_STATE_TEXT_NEXT:
-				off = 0; ignore = 0; *sz = 0;
-				data->type = T_TYPE_TEXT;
-
-				/* Skip leading whitespace if requested */
-				if( data->flags & T_FLAG_SKIPWS )
-				{
-					data->flags &= ~T_FLAG_SKIPWS;
-					while( (off < data->bufsize) && isspace(data->buf[off]) )
-						off++;
-				}
-
-				/* Found "<%" */
-				if( (match = strfind(&data->buf[off], data->bufsize - off - 1, T_TOK_START, strlen(T_TOK_START))) != NULL )
-				{
-					readlen = (int)(match - &data->buf[off]);
-					data->bufsize -= (readlen + strlen(T_TOK_START) + off);
-					match += strlen(T_TOK_START);
-
-					/* Check for leading '-' */
-					if( match[0] == T_TOK_SKIPWS[0] )
-					{
-						data->bufsize--;
-						match++;
-
-						while( (readlen > 1) && isspace(data->buf[off+readlen-1]) )
-						{
-							readlen--;
-						}
-					}
-
-					bufout(data, &data->buf[off], readlen);
-					bufmove(data, match);
-					data->state = T_STATE_CODE_INIT;
-				}
-
-				/* Maybe plain chunk */
-				else
-				{
-					/* Preserve trailing "<" or white space, maybe a start token */
-					vague = stokscan(data, off, 0);
-
-					/* We can process some bytes ... */
-					if( vague < data->bufsize )
-					{
-						readlen = data->bufsize - vague - off;
-					}
-
-					/* No bytes to process, so try to remove at least whitespace ... */
-					else
-					{
-						/* ... but try to preserve trailing "<" ... */
-						vague = stokscan(data, off, 1);
-
-						if( vague < data->bufsize )
-						{
-							readlen = data->bufsize - vague - off;
-						}
-
-						/* ... no chance, push out buffer */
-						else
-						{
-							readlen = vague - off;
-							vague   = 0;
-						}
-					}
-
-					bufout(data, &data->buf[off], readlen);
-
-					data->state   = T_STATE_TEXT_NEXT;
-					data->bufsize = vague;
-					bufmove(data, &data->buf[off+readlen]);
-				}
-
-				if( ignore || data->outsize == 0 )
-					continue;
-				else
-					return generate_expression(data, sz, T_GEN_START | T_GEN_END);
-
-				break;
-
-			/* Ignored chunk (inside "<%# ... %>") */
-			case T_STATE_SKIP:
-				ignore = 1;
-
-			/* Initial code chunk ("<% ...") */
-			case T_STATE_CODE_INIT:
-				off = 0;
-
-				/* Check for leading '-' */
-				if( data->buf[off] == T_TOK_SKIPWS[0] )
-					off++;
-
-				/* Determine code type */
-				switch(data->buf[off])
-				{
-					case '#':
-						ignore = 1;
-						off++;
-						data->type = T_TYPE_COMMENT;
-						break;
-
-					case '=':
-						off++;
-						data->type = T_TYPE_EXPR;
-						break;
-
-					case '+':
-						off++;
-						data->type = T_TYPE_INCLUDE;
-						break;
-
-					case ':':
-						off++;
-						data->type = T_TYPE_I18N;
-						break;
-
-					case '_':
-						off++;
-						data->type = T_TYPE_I18N_RAW;
-						break;
-
-					default:
-						data->type = T_TYPE_CODE;
-						break;
-				}
-
-			/* Subsequent code chunk ("..." or "... %>") */ 
-			case T_STATE_CODE_NEXT:
-				/* Found "%>" */
-				if( (match = strfind(&data->buf[off], data->bufsize - off, T_TOK_END, strlen(T_TOK_END))) != NULL )
-				{
-					genflags = ( data->state == T_STATE_CODE_INIT )
-						? (T_GEN_START | T_GEN_END) : T_GEN_END;
-
-					readlen = (int)(match - &data->buf[off]);
-
-					/* Check for trailing '-' */
-					if( (match > data->buf) && (*(match-1) == T_TOK_SKIPWS[0]) )
-					{
-						readlen--;
-						data->flags |= T_FLAG_SKIPWS;
-					}
-
-					bufout(data, &data->buf[off], readlen);
-
-					data->state = T_STATE_TEXT_INIT;
-					data->bufsize -= ((int)(match - &data->buf[off]) + strlen(T_TOK_END) + off);
-					bufmove(data, &match[strlen(T_TOK_END)]);
-				}
-
-				/* Code chunk */
-				else
-				{
-					genflags = ( data->state == T_STATE_CODE_INIT ) ? T_GEN_START : 0;
-
-					/* Preserve trailing "%" and "-", maybe an end token */
-					vague   = etokscan(data);
-					readlen = data->bufsize - off - vague;
-					bufout(data, &data->buf[off], readlen);
-
-					data->state   = T_STATE_CODE_NEXT;
-					data->bufsize = vague;
-					bufmove(data, &data->buf[readlen+off]);
-				}
-
-				if( ignore || (data->outsize == 0 && !genflags) )
-					continue;
-				else
-					return generate_expression(data, sz, genflags);
-
-				break;
-		}
+	if( parser->done )
+	{
+		*sz = 0;
+		return NULL;
 	}
 
-	*sz = 0;
-	return NULL;
-}
-
+	parser->done = 1;
+	*sz = buf_length(parser->out);
 
+	return (const char *)parser->out->data;
+}
@@ -25,25 +25,15 @@
 #include <fcntl.h>
 #include <string.h>
 #include <ctype.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 
 #include <lua.h>
 #include <lualib.h>
 #include <lauxlib.h>
 
+#include "template_utils.h"
 
-#define T_READBUFSZ			1024
-#define T_OUTBUFSZ			T_READBUFSZ * 3
-
-/* parser states */
-#define T_STATE_TEXT_INIT	0
-#define T_STATE_TEXT_NEXT	1
-#define T_STATE_CODE_INIT	2
-#define T_STATE_CODE_NEXT	3
-#define T_STATE_SKIP 		4
-
-/* parser flags */
-#define T_FLAG_EOF			0x01
-#define T_FLAG_SKIPWS		0x02
 
 /* tokens used in matching and expression generation */
 #define T_TOK_START			"<%"
@@ -66,16 +56,16 @@
 /* parser state */
 struct template_parser {
 	int fd;
-	int bufsize;
-	int outsize;
-	int state;
-	int flags;
-	int type;
-	char buf[T_READBUFSZ];
-	char out[T_OUTBUFSZ];
+	size_t size;
+	char *mmap;
+	int done;
+	struct template_buffer *out;
 };
 
 
+struct template_parser * template_open(const char *file);
+void template_close(struct template_parser *parser);
+
 const char *template_reader(lua_State *L, void *ud, size_t *sz);
 
 #endif
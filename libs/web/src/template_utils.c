@@ -18,17 +18,24 @@
 
 #include "template_utils.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 /* initialize a buffer object */
-static struct template_buffer * buf_init(void)
+struct template_buffer * buf_init(int size)
 {
 	struct template_buffer *buf;
 
+	if (size <= 0)
+		size = 1024;
+
 	buf = (struct template_buffer *)malloc(sizeof(struct template_buffer));
 
 	if (buf != NULL)
 	{
 		buf->fill = 0;
-		buf->size = 1024;
+		buf->size = size;
 		buf->data = (unsigned char *)malloc(buf->size);
 
 		if (buf->data != NULL)
@@ -45,18 +52,19 @@ static struct template_buffer * buf_init(void)
 	return NULL;
 }
 
-/* grow buffer */
-static int buf_grow(struct template_buffer *buf)
+/* grow buffer, doubling its size up to 64K and in 64K steps beyond */
+int buf_grow(struct template_buffer *buf)
 {
 	unsigned int off = (buf->dptr - buf->data);
+	unsigned int add = (buf->size < 65536) ? buf->size : 65536;
 	unsigned char *data =
-		(unsigned char *)realloc(buf->data, buf->size + 1024);
+		(unsigned char *)realloc(buf->data, buf->size + add);
 
 	if (data != NULL)
 	{
 		buf->data  = data;
 		buf->dptr  = data + off;
-		buf->size += 1024;
+		buf->size += add;
 
 		return buf->size;
 	}
@@ -65,7 +73,7 @@ static int buf_grow(struct template_buffer *buf)
 }
 
 /* put one char into buffer object */
-static int buf_putchar(struct template_buffer *buf, unsigned char c)
+int buf_putchar(struct template_buffer *buf, unsigned char c)
 {
 	if( ((buf->fill + 1) >= buf->size) && !buf_grow(buf) )
 		return 0;
@@ -78,7 +86,7 @@ static int buf_putchar(struct template_buffer *buf, unsigned char c)
 }
 
 /* append data to buffer */
-static int buf_append(struct template_buffer *buf, unsigned char *s, int len)
+int buf_append(struct template_buffer *buf, const unsigned char *s, int len)
 {
 	while ((buf->fill + len + 1) >= buf->size)
 	{
@@ -95,8 +103,14 @@ static int buf_append(struct template_buffer *buf, unsigned char *s, int len)
 	return len;
 }
 
+/* return the length of the buffer contents */
+int buf_length(struct template_buffer *buf)
+{
+	return buf->fill;
+}
+
 /* destroy buffer object and return pointer to data */
-static char * buf_destroy(struct template_buffer *buf)
+char * buf_destroy(struct template_buffer *buf)
 {
 	unsigned char *data = buf->data;
 
@@ -263,23 +277,140 @@ static int _validate_utf8(unsigned char **s, int l, struct template_buffer *buf)
 	return o;
 }
 
+/*
+ * Span helpers, return the number of leading bytes which can be copied
+ * verbatim. Runs are tested 16 bytes at a time with SSE2 where available
+ * and a machine word at a time otherwise; the remaining tail and the first
+ * byte which needs attention are handled by the scalar loops below.
+ */
+#define W_ONES			(~0UL / 255)
+#define W_HIGHS			(W_ONES * 0x80)
+#define W_ZERO(x)		(((x) - W_ONES) & ~(x) & W_HIGHS)
+#define W_LESS(x, n)	(((x) - W_ONES * (n)) & ~(x) & W_HIGHS)
+#define W_MORE(x, n)	((((x) + W_ONES * (127 - (n))) | (x)) & W_HIGHS)
+#define W_HAS(x, c)		W_ZERO((x) ^ (W_ONES * (c)))
+
+static inline int utf8_plain(unsigned char c)
+{
+	return ((c >= 0x01) && (c <= 0x7F));
+}
+
+static inline int pcdata_plain(unsigned char c)
+{
+	return ((c >= 0x20) && (c <= 0x7E) && (c != 0x26) && (c != 0x27) &&
+	        (c != 0x22) && (c != 0x3C) && (c != 0x3E));
+}
+
+static unsigned int utf8_span(const unsigned char *s, unsigned int l)
+{
+	unsigned int i = 0;
+
+#ifdef __SSE2__
+	const __m128i zero = _mm_setzero_si128();
+	__m128i v;
+
+	for (; (i + 16) <= l; i += 16)
+	{
+		v = _mm_loadu_si128((const __m128i *)(s + i));
+
+		/* high bit set or nul byte */
+		if (_mm_movemask_epi8(_mm_or_si128(v, _mm_cmpeq_epi8(v, zero))))
+			break;
+	}
+#else
+	unsigned long w;
+
+	for (; (i + sizeof(w)) <= l; i += sizeof(w))
+	{
+		memcpy(&w, s + i, sizeof(w));
+
+		if ((w & W_HIGHS) || W_ZERO(w))
+			break;
+	}
+#endif
+
+	while ((i < l) && utf8_plain(s[i]))
+		i++;
+
+	return i;
+}
+
+static unsigned int pcdata_span(const unsigned char *s, unsigned int l)
+{
+	unsigned int i = 0;
+
+#ifdef __SSE2__
+	const __m128i lo = _mm_set1_epi8(0x1F);
+	const __m128i hi = _mm_set1_epi8(0x7F);
+	__m128i v, ok, esc;
+
+	for (; (i + 16) <= l; i += 16)
+	{
+		v = _mm_loadu_si128((const __m128i *)(s + i));
+
+		/* signed compare, bytes >= 0x80 fail the lower bound */
+		ok  = _mm_and_si128(_mm_cmpgt_epi8(v, lo), _mm_cmplt_epi8(v, hi));
+		esc = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(0x26)),
+			             _mm_cmpeq_epi8(v, _mm_set1_epi8(0x27))),
+			_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(0x22)),
+			             _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(0x3C)),
+			                          _mm_cmpeq_epi8(v, _mm_set1_epi8(0x3E)))));
+
+		if (_mm_movemask_epi8(_mm_andnot_si128(esc, ok)) != 0xFFFF)
+			break;
+	}
+#else
+	unsigned long w;
+
+	for (; (i + sizeof(w)) <= l; i += sizeof(w))
+	{
+		memcpy(&w, s + i, sizeof(w));
+
+		if (W_LESS(w, 0x20) || W_MORE(w, 0x7E) ||
+		    W_HAS(w, 0x26) || W_HAS(w, 0x27) || W_HAS(w, 0x22) ||
+		    W_HAS(w, 0x3C) || W_HAS(w, 0x3E))
+			break;
+	}
+#endif
+
+	while ((i < l) && pcdata_plain(s[i]))
+		i++;
+
+	return i;
+}
+
+/* test whether the given string needs no sanitizing at all */
+int sanitize_utf8_clean(const char *s, unsigned int l)
+{
+	return (utf8_span((const unsigned char *)s, l) == l);
+}
+
+int sanitize_pcdata_clean(const char *s, unsigned int l)
+{
+	return (pcdata_span((const unsigned char *)s, l) == l);
+}
+
 /* sanitize given string and replace all invalid UTF-8 sequences with "?" */
 char * sanitize_utf8(const char *s, unsigned int l)
 {
-	struct template_buffer *buf = buf_init();
+	struct template_buffer *buf = buf_init(l + 1);
 	unsigned char *ptr = (unsigned char *)s;
 	unsigned int v, o;
 
 	if (!buf)
 		return NULL;
 
-	for (o = 0; o < l; o++)
+	for (o = 0; o < l; )
 	{
-		/* ascii char */
-		if ((*ptr >= 0x01) && (*ptr <= 0x7F))
+		/* run of ascii chars */
+		if ((v = utf8_span(ptr, l - o)) > 0)
 		{
-			if (!buf_putchar(buf, *ptr++))
+			if (!buf_append(buf, ptr, v))
 				break;
+
+			ptr += v;
+			o += v;
 		}
 
 		/* invalid byte or multi byte sequence */
@@ -288,7 +419,7 @@ char * sanitize_utf8(const char *s, unsigned int l)
 			if (!(v = _validate_utf8(&ptr, l - o, buf)))
 				break;
 
-			o += (v - 1);
+			o += v;
 		}
 	}
 
@@ -300,7 +431,7 @@ char * sanitize_utf8(const char *s, unsigned int l)
  * Escape XML control chars */
 char * sanitize_pcdata(const char *s, unsigned int l)
 {
-	struct template_buffer *buf = buf_init();
+	struct template_buffer *buf = buf_init(l + (l / 8) + 1);
 	unsigned char *ptr = (unsigned char *)s;
 	unsigned int o, v;
 	char esq[8];
@@ -309,15 +440,26 @@ char * sanitize_pcdata(const char *s, unsigned int l)
 	if (!buf)
 		return NULL;
 
-	for (o = 0; o < l; o++)
+	for (o = 0; o < l; )
 	{
+		/* run of plain ascii chars */
+		if ((v = pcdata_span(ptr, l - o)) > 0)
+		{
+			if (!buf_append(buf, ptr, v))
+				break;
+
+			ptr += v;
+			o += v;
+		}
+
 		/* Invalid XML bytes */
-		if (((*ptr >= 0x00) && (*ptr <= 0x08)) ||
-		    ((*ptr >= 0x0B) && (*ptr <= 0x0C)) ||
-		    ((*ptr >= 0x0E) && (*ptr <= 0x1F)) ||
-		    (*ptr == 0x7F))
+		else if ((*ptr <= 0x08) ||
+		         ((*ptr >= 0x0B) && (*ptr <= 0x0C)) ||
+		         ((*ptr >= 0x0E) && (*ptr <= 0x1F)) ||
+		         (*ptr == 0x7F))
 		{
 			ptr++;
+			o++;
 		}
 
 		/* Escapes */
@@ -333,12 +475,16 @@ char * sanitize_pcdata(const char *s, unsigned int l)
 				break;
 
 			ptr++;
+			o++;
 		}
 
-		/* ascii char */
+		/* remaining ascii chars (\t, \n and \r) */
 		else if (*ptr <= 0x7F)
 		{
-			buf_putchar(buf, *ptr++);
+			if (!buf_putchar(buf, *ptr++))
+				break;
+
+			o++;
 		}
 
 		/* multi byte sequence */
@@ -347,7 +493,7 @@ char * sanitize_pcdata(const char *s, unsigned int l)
 			if (!(v = _validate_utf8(&ptr, l - o, buf)))
 				break;
 
-			o += (v - 1);
+			o += v;
 		}
 	}
 
@@ -32,6 +32,16 @@ struct template_buffer {
 	unsigned int fill;
 };
 
+struct template_buffer * buf_init(int size);
+int buf_grow(struct template_buffer *buf);
+int buf_putchar(struct template_buffer *buf, unsigned char c);
+int buf_append(struct template_buffer *buf, const unsigned char *s, int len);
+int buf_length(struct template_buffer *buf);
+char * buf_destroy(struct template_buffer *buf);
+
+int sanitize_utf8_clean(const char *s, unsigned int l);
+int sanitize_pcdata_clean(const char *s, unsigned int l);
+
 char * sanitize_utf8(const char *s, unsigned int l);
 char * sanitize_pcdata(const char *s, unsigned int l);
 
@@ -37,6 +37,8 @@ function index()
 
 	entry({"admin", "status", "realtime", "connections"}, template("admin_status/connections"), _("Connections"), 4).leaf = true
 	entry({"admin", "status", "realtime", "connections_status"}, call("action_connections")).leaf = true
+
+	entry({"admin", "status", "realtime", "export_status"}, call("action_export")).leaf = true
 end
 
 function action_syslog()
@@ -70,86 +72,52 @@ function action_iptables()
 end
 
 function action_bandwidth()
+	local bwc   = require "luci.bwc"
 	local path  = luci.dispatcher.context.requestpath
 	local iface = path[#path]
 
 	luci.http.prepare_content("application/json")
-
-	local bwc = io.popen("luci-bwc -i %q 2>/dev/null" % iface)
-	if bwc then
-		luci.http.write("[")
-
-		while true do
-			local ln = bwc:read("*l")
-			if not ln then break end
-			luci.http.write(ln)
-		end
-
-		luci.http.write("]")
-		bwc:close()
-	end
+	luci.http.write(bwc.interface(iface) or "[]")
 end
 
 function action_wireless()
+	local bwc   = require "luci.bwc"
 	local path  = luci.dispatcher.context.requestpath
 	local iface = path[#path]
 
 	luci.http.prepare_content("application/json")
-
-	local bwc = io.popen("luci-bwc -r %q 2>/dev/null" % iface)
-	if bwc then
-		luci.http.write("[")
-
-		while true do
-			local ln = bwc:read("*l")
-			if not ln then break end
-			luci.http.write(ln)
-		end
-
-		luci.http.write("]")
-		bwc:close()
-	end
+	luci.http.write(bwc.radio(iface) or "[]")
 end
 
 function action_load()
-	luci.http.prepare_content("application/json")
+	local bwc = require "luci.bwc"
 
-	local bwc = io.popen("luci-bwc -l 2>/dev/null")
-	if bwc then
-		luci.http.write("[")
-
-		while true do
-			local ln = bwc:read("*l")
-			if not ln then break end
-			luci.http.write(ln)
-		end
-
-		luci.http.write("]")
-		bwc:close()
-	end
+	luci.http.prepare_content("application/json")
+	luci.http.write(bwc.load() or "[]")
 end
 
 function action_connections()
 	local sys = require "luci.sys"
+	local bwc = require "luci.bwc"
 
 	luci.http.prepare_content("application/json")
 
 	luci.http.write("{ connections: ")
 	luci.http.write_json(sys.net.conntrack())
 
-	local bwc = io.popen("luci-bwc -c 2>/dev/null")
-	if bwc then
-		luci.http.write(", statistics: [")
+	luci.http.write(", statistics: ")
+	luci.http.write(bwc.connections() or "[]")
 
-		while true do
-			local ln = bwc:read("*l")
-			if not ln then break end
-			luci.http.write(ln)
-		end
+	luci.http.write(" }")
+end
 
-		luci.http.write("]")
-		bwc:close()
-	end
+function action_export()
+	local bwc    = require "luci.bwc"
+	local series = luci.http.formvalue("series")
+	local tier   = tonumber(luci.http.formvalue("tier")) or 0
+	local since  = tonumber(luci.http.formvalue("since")) or 0
 
-	luci.http.write(" }")
+	luci.http.prepare_content("application/json")
+	luci.http.write(bwc.export(series and luci.util.split(series, ","),
+		tier, since))
 end
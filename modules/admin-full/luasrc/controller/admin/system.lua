@@ -22,6 +22,7 @@ function index()
 
 	entry({"admin", "system", "admin"}, cbi("admin_system/admin"), _("Administration"), 2)
 
+	treedepend("/bin")
 	if nixio.fs.access("/bin/opkg") then
 		entry({"admin", "system", "packages"}, call("action_packages"), _("Software"), 10)
 		entry({"admin", "system", "packages", "ipkg"}, form("admin_system/ipkg"))
@@ -52,7 +53,7 @@ function action_clock_status()
 		local date = os.date("*t", set)
 		if date then
 			-- prevent session timeoutby updating mtime
-			nixio.fs.utimes(luci.sauth.sessionpath .. "/" .. luci.dispatcher.context.authsession, set, set)
+			luci.sauth.touch(luci.dispatcher.context.authsession, set)
 
 			luci.sys.call("date -s '%04d-%02d-%02d %02d:%02d:%02d'" %{
 				date.year, date.month, date.day, date.hour, date.min, date.sec
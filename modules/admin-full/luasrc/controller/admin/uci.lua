@@ -16,14 +16,22 @@ $Id$
 module("luci.controller.admin.uci", package.seeall)
 
 function index()
-	local redir = luci.http.formvalue("redir", true) or
-	  luci.dispatcher.build_url(unpack(luci.dispatcher.context.request))
-
 	entry({"admin", "uci"}, nil, _("Configuration"))
-	entry({"admin", "uci", "changes"}, call("action_changes"), _("Changes"), 40).query = {redir=redir}
-	entry({"admin", "uci", "revert"}, call("action_revert"), _("Revert"), 30).query = {redir=redir}
-	entry({"admin", "uci", "apply"}, call("action_apply"), _("Apply"), 20).query = {redir=redir}
-	entry({"admin", "uci", "saveapply"}, call("action_apply"), _("Save &#38; Apply"), 10).query = {redir=redir}
+	entry({"admin", "uci", "changes"}, call("action_changes"), _("Changes"), 40)
+	entry({"admin", "uci", "revert"}, call("action_revert"), _("Revert"), 30)
+	entry({"admin", "uci", "apply"}, call("action_apply"), _("Apply"), 20)
+	entry({"admin", "uci", "saveapply"}, call("action_apply"), _("Save &#38; Apply"), 10)
+end
+
+-- The page to return to, either passed on or the referring page. The index
+-- does not depend on the request so it can be kept in a tree snapshot.
+local function redirect_target()
+	local redir = luci.http.formvalue("redir", true)
+	if not redir then
+		local referer = luci.http.getenv("HTTP_REFERER")
+		redir = referer and referer:match("^%w+://[^/]+(/.*)$")
+	end
+	return redir
 end
 
 function action_changes()
@@ -31,7 +39,8 @@ function action_changes()
 	local changes = uci:changes()
 
 	luci.template.render("admin_uci/changes", {
-		changes = next(changes) and changes
+		changes = next(changes) and changes,
+		redir   = redirect_target()
 	})
 end
 
@@ -70,6 +79,7 @@ function action_revert()
 	end
 
 	luci.template.render("admin_uci/revert", {
-		changes = next(changes) and changes
+		changes = next(changes) and changes,
+		redir   = redirect_target()
 	})
 end
@@ -0,0 +1,364 @@
+/*
+ * luci-bwc - Very simple bandwidth collector cache for LuCI realtime graphs
+ *
+ * Database access functions
+ *
+ *   Copyright (C) 2010 Jo-Philipp Wich <xm@subsignal.org>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <dirent.h>
+
+#include "luci-bwc.h"
+
+
+int readpid(void)
+{
+	int fd;
+	int pid = -1;
+	char buf[9] = { 0 };
+
+	if ((fd = open(PID_PATH, O_RDONLY)) > -1)
+	{
+		if (read(fd, buf, sizeof(buf)))
+		{
+			buf[8] = 0;
+			pid = atoi(buf);
+		}
+
+		close(fd);
+	}
+
+	return pid;
+}
+
+int mmap_file(const char *path, int rw, struct file_map *m)
+{
+	struct stat s;
+
+	m->fd   = -1;
+	m->size = -1;
+	m->mmap = NULL;
+
+	if ((m->fd = open(path, rw ? O_RDWR : O_RDONLY)) >= 0 &&
+	    !fstat(m->fd, &s) && (s.st_size > 0))
+	{
+		m->size = s.st_size;
+		m->mmap = mmap(NULL, m->size, rw ? (PROT_READ | PROT_WRITE) : PROT_READ,
+					   MAP_SHARED | MAP_LOCKED, m->fd, 0);
+
+		if ((m->mmap != NULL) && (m->mmap != MAP_FAILED))
+			return 0;
+
+		m->mmap = NULL;
+	}
+
+	return -1;
+}
+
+void umap_file(struct file_map *m)
+{
+	if ((m->mmap != NULL) && (m->mmap != MAP_FAILED))
+		munmap(m->mmap, m->size);
+
+	if (m->fd > -1)
+		close(m->fd);
+
+	m->fd   = -1;
+	m->mmap = NULL;
+}
+
+/* Validate the header and tier layout of a mapped database */
+int db_check(struct file_map *m, int esize)
+{
+	int i;
+	struct db_header *h = (struct db_header *)m->mmap;
+	struct db_tier *t;
+
+	if ((m->size < (int)sizeof(*h)) ||
+	    (ntohl(h->magic) != DB_MAGIC) || (ntohs(h->version) != DB_VERSION) ||
+	    (ntohs(h->esize) != esize) ||
+	    (ntohl(h->ntiers) < 1) || (ntohl(h->ntiers) > DB_TIERS))
+		goto inval;
+
+	for (i = 0; i < ntohl(h->ntiers); i++)
+	{
+		t = &h->tiers[i];
+
+		if (!ntohl(t->step) || !ntohl(t->count) ||
+		    (ntohl(t->head) >= ntohl(t->count)) ||
+		    (ntohl(t->offset) < sizeof(*h)) ||
+		    ((ntohl(t->offset) + ntohl(t->count) * esize) > m->size))
+			goto inval;
+	}
+
+	return 0;
+
+inval:
+	errno = EINVAL;
+	return -1;
+}
+
+
+/*
+ * Return the next entry of the given tier, walking from the oldest to the
+ * most recent one. Empty slots and slots out of time order are skipped.
+ */
+char * db_next(struct file_map *m, int tier, int *pos, uint32_t *last)
+{
+	struct db_header *h = (struct db_header *)m->mmap;
+	struct db_tier *t = &h->tiers[tier];
+	uint32_t count = ntohl(t->count);
+	uint32_t head = ntohl(t->head);
+	char *e;
+
+	while (*pos < count)
+	{
+		e = db_entry(m, t, (head + 1 + (*pos)++) % count);
+
+		if (timeof(e) > *last)
+		{
+			*last = timeof(e);
+			return e;
+		}
+	}
+
+	return NULL;
+}
+
+int format_traffic(char *buf, int len, const void *entry)
+{
+	const struct traffic_entry *e = entry;
+
+	return snprintf(buf, len,
+		"[ %u, %" PRIu64 ", %" PRIu64 ", %" PRIu64 ", %" PRIu64 " ]",
+		ntohl(e->time),
+		ntoh64(e->rxb), ntoh64(e->rxp),
+		ntoh64(e->txb), ntoh64(e->txp));
+}
+
+int format_radio(char *buf, int len, const void *entry)
+{
+	const struct radio_entry *e = entry;
+
+	return snprintf(buf, len, "[ %u, %d, %d, %d ]",
+		ntohl(e->time),
+		ntohs(e->rate), e->rssi, e->noise);
+}
+
+int format_conns(char *buf, int len, const void *entry)
+{
+	const struct conn_entry *e = entry;
+
+	return snprintf(buf, len, "[ %u, %u, %u, %u ]",
+		ntohl(e->time), ntohl(e->udp),
+		ntohl(e->tcp), ntohl(e->other));
+}
+
+int format_load(char *buf, int len, const void *entry)
+{
+	const struct load_entry *e = entry;
+
+	return snprintf(buf, len, "[ %u, %u, %u, %u ]",
+		ntohl(e->time),
+		ntohs(e->load1), ntohs(e->load5), ntohs(e->load15));
+}
+
+
+/* known series, names ending with a slash denote a directory of databases */
+static const struct db_series {
+	const char *name;
+	int esize;
+	int (*format)(char *, int, const void *);
+} db_series[] = {
+	{ "if/",         sizeof(struct traffic_entry), format_traffic },
+	{ "radio/",      sizeof(struct radio_entry),   format_radio   },
+	{ "connections", sizeof(struct conn_entry),    format_conns   },
+	{ "load",        sizeof(struct load_entry),    format_load    },
+};
+
+#define DB_SERIES_COUNT (sizeof(db_series) / sizeof(db_series[0]))
+
+static const struct db_series * db_lookup(const char *name)
+{
+	int i, l;
+
+	for (i = 0; i < DB_SERIES_COUNT; i++)
+	{
+		l = strlen(db_series[i].name);
+
+		if (db_series[i].name[l-1] == '/')
+		{
+			if (!strncmp(name, db_series[i].name, l) &&
+			    name[l] && (name[l] != '.') && !strchr(&name[l], '/'))
+				return &db_series[i];
+		}
+		else if (!strcmp(name, db_series[i].name))
+		{
+			return &db_series[i];
+		}
+	}
+
+	return NULL;
+}
+
+static int db_open(const char *name, int tier, struct file_map *m,
+                   const struct db_series **series)
+{
+	char path[1024];
+
+	m->fd   = -1;
+	m->mmap = NULL;
+
+	if (!(*series = db_lookup(name)))
+	{
+		errno = ENOENT;
+		return -1;
+	}
+
+	snprintf(path, sizeof(path), "%s/%s", DB_PATH, name);
+
+	if (mmap_file(path, 0, m) || db_check(m, (*series)->esize))
+		goto err;
+
+	if ((tier < 0) || (tier >= ntohl(((struct db_header *)m->mmap)->ntiers)))
+	{
+		errno = ERANGE;
+		goto err;
+	}
+
+	return 0;
+
+err:
+	umap_file(m);
+	return -1;
+}
+
+static void db_write_entries(struct file_map *m, const struct db_series *series,
+                             int tier, uint32_t since, db_write_t write, void *ctx)
+{
+	int i, n, len;
+	char line[128];
+	char *e;
+
+	write(ctx, "[", 1);
+
+	for (i = 0, n = 0; (e = db_next(m, tier, &i, &since)) != NULL; n++)
+	{
+		if (n)
+			write(ctx, ",", 1);
+
+		len = series->format(line, sizeof(line), e);
+		write(ctx, line, len);
+	}
+
+	write(ctx, "]", 1);
+}
+
+int db_dump(const char *name, int tier, uint32_t since,
+            db_write_t write, void *ctx)
+{
+	struct file_map m;
+	const struct db_series *series;
+
+	if (db_open(name, tier, &m, &series))
+		return -1;
+
+	db_write_entries(&m, series, tier, since, write, ctx);
+	umap_file(&m);
+
+	return 0;
+}
+
+static void db_export_one(const char *name, int tier, uint32_t since, int *n,
+                          db_write_t write, void *ctx)
+{
+	struct file_map m;
+	const struct db_series *series;
+	const char *p;
+
+	if (db_open(name, tier, &m, &series))
+		return;
+
+	if ((*n)++)
+		write(ctx, ",", 1);
+
+	write(ctx, "\"", 1);
+
+	for (p = name; *p; p++)
+	{
+		if ((*p == '"') || (*p == '\\'))
+			write(ctx, "\\", 1);
+
+		if ((unsigned char)*p >= 0x20)
+			write(ctx, p, 1);
+	}
+
+	write(ctx, "\":", 2);
+	db_write_entries(&m, series, tier, since, write, ctx);
+	umap_file(&m);
+}
+
+/*
+ * Write the given series, or all existing ones if names is NULL, as one JSON
+ * object keyed by series name. Series which cannot be read are left out.
+ */
+void db_export(const char **names, int count, int tier, uint32_t since,
+               db_write_t write, void *ctx)
+{
+	int i, n = 0;
+	char path[1024];
+	char name[256];
+	DIR *dir;
+	struct dirent *e;
+
+	write(ctx, "{", 1);
+
+	if (names)
+	{
+		for (i = 0; i < count; i++)
+			db_export_one(names[i], tier, since, &n, write, ctx);
+	}
+	else
+	{
+		for (i = 0; i < DB_SERIES_COUNT; i++)
+		{
+			if (db_series[i].name[strlen(db_series[i].name)-1] != '/')
+			{
+				db_export_one(db_series[i].name, tier, since, &n, write, ctx);
+				continue;
+			}
+
+			snprintf(path, sizeof(path), "%s/%s", DB_PATH, db_series[i].name);
+
+			if ((dir = opendir(path)) != NULL)
+			{
+				while ((e = readdir(dir)) != NULL)
+				{
+					if (e->d_name[0] == '.')
+						continue;
+
+					snprintf(name, sizeof(name), "%s%s",
+					         db_series[i].name, e->d_name);
+
+					db_export_one(name, tier, since, &n, write, ctx);
+				}
+
+				closedir(dir);
+			}
+		}
+	}
+
+	write(ctx, "}", 1);
+}
@@ -0,0 +1,180 @@
+/*
+ * luci-bwc - Very simple bandwidth collector cache for LuCI realtime graphs
+ *
+ * Lua binding, reads the collector databases in-process
+ *
+ *   Copyright (C) 2010 Jo-Philipp Wich <xm@subsignal.org>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <signal.h>
+#include <sys/wait.h>
+
+#include <lua.h>
+#include <lualib.h>
+#include <lauxlib.h>
+
+#include "luci-bwc.h"
+
+#define BWC_LUALIB_META	"luci.bwc"
+
+
+/*
+ * Reset the countdown of the running collector. The collector binary is
+ * only spawned if no daemon answers, which happens once after it timed out.
+ */
+static int bwc_ping(void)
+{
+	int pid;
+	pid_t child;
+
+	if (((pid = readpid()) > 0) && !kill(pid, SIGUSR1))
+		return 0;
+
+	switch ((child = fork()))
+	{
+		case -1:
+			return -1;
+
+		case 0:
+			execl(BWC_PATH, BWC_PATH, "-p", NULL);
+			_exit(1);
+
+		default:
+			while ((waitpid(child, NULL, 0) < 0) && (errno == EINTR));
+			return 0;
+	}
+}
+
+static void bwc_write(void *ctx, const char *data, int len)
+{
+	luaL_addlstring((luaL_Buffer *)ctx, data, len);
+}
+
+static int bwc_L_dump(lua_State *L, const char *name, int tier, uint32_t since)
+{
+	luaL_Buffer b;
+
+	bwc_ping();
+	luaL_buffinit(L, &b);
+
+	/* nothing is written to the buffer if the series cannot be read */
+	if (db_dump(name, tier, since, bwc_write, &b))
+	{
+		lua_pushnil(L);
+		lua_pushfstring(L, "Failed to read %s: %s", name, strerror(errno));
+		return 2;
+	}
+
+	luaL_pushresult(&b);
+	return 1;
+}
+
+/* interface(ifname [, tier [, since]]) - traffic samples as JSON array */
+static int bwc_L_interface(lua_State *L)
+{
+	char name[256];
+
+	snprintf(name, sizeof(name), "if/%s", luaL_checkstring(L, 1));
+
+	return bwc_L_dump(L, name, luaL_optint(L, 2, 0), luaL_optnumber(L, 3, 0));
+}
+
+/* radio(ifname [, tier [, since]]) - wireless samples as JSON array */
+static int bwc_L_radio(lua_State *L)
+{
+	char name[256];
+
+	snprintf(name, sizeof(name), "radio/%s", luaL_checkstring(L, 1));
+
+	return bwc_L_dump(L, name, luaL_optint(L, 2, 0), luaL_optnumber(L, 3, 0));
+}
+
+/* connections([tier [, since]]) - conntrack samples as JSON array */
+static int bwc_L_connections(lua_State *L)
+{
+	return bwc_L_dump(L, "connections",
+	                  luaL_optint(L, 1, 0), luaL_optnumber(L, 2, 0));
+}
+
+/* load([tier [, since]]) - load average samples as JSON array */
+static int bwc_L_load(lua_State *L)
+{
+	return bwc_L_dump(L, "load",
+	                  luaL_optint(L, 1, 0), luaL_optnumber(L, 2, 0));
+}
+
+/*
+ * export([series [, tier [, since]]]) - the given series, or all existing
+ * ones, as JSON object keyed by series name
+ */
+static int bwc_L_export(lua_State *L)
+{
+	int i, count = 0;
+	const char **names = NULL;
+	int tier = luaL_optint(L, 2, 0);
+	uint32_t since = luaL_optnumber(L, 3, 0);
+	luaL_Buffer b;
+
+	if (!lua_isnoneornil(L, 1))
+	{
+		luaL_checktype(L, 1, LUA_TTABLE);
+		count = lua_objlen(L, 1);
+
+		if (!(names = malloc((count + 1) * sizeof(*names))))
+			return luaL_error(L, "Out of memory");
+
+		/* the strings stay referenced by the table */
+		for (i = 0; i < count; i++)
+		{
+			lua_rawgeti(L, 1, i + 1);
+			names[i] = (lua_type(L, -1) == LUA_TSTRING) ? lua_tostring(L, -1) : "";
+			lua_pop(L, 1);
+		}
+	}
+
+	bwc_ping();
+
+	luaL_buffinit(L, &b);
+	db_export(names, count, tier, since, bwc_write, &b);
+	luaL_pushresult(&b);
+
+	free(names);
+
+	return 1;
+}
+
+/* ping() - keep the collector running */
+static int bwc_L_ping(lua_State *L)
+{
+	lua_pushboolean(L, !bwc_ping());
+	return 1;
+}
+
+
+/* module table */
+static const luaL_reg R[] = {
+	{ "interface",		bwc_L_interface },
+	{ "radio",			bwc_L_radio },
+	{ "connections",	bwc_L_connections },
+	{ "load",			bwc_L_load },
+	{ "export",			bwc_L_export },
+	{ "ping",			bwc_L_ping },
+	{ NULL,				NULL }
+};
+
+LUALIB_API int luaopen_luci_bwc(lua_State *L) {
+	luaL_register(L, BWC_LUALIB_META, R);
+	return 1;
+}
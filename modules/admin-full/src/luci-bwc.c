@@ -16,99 +16,66 @@
  * limitations under the License.
  */
 
-#include <stdlib.h>
-#include <stdio.h>
-#include <string.h>
-#include <stdint.h>
-#include <inttypes.h>
-#include <fcntl.h>
 #include <time.h>
-#include <errno.h>
-#include <unistd.h>
 #include <signal.h>
 
-#include <sys/stat.h>
-#include <sys/mman.h>
-#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/sysinfo.h>
+#include <netinet/in.h>
 
-#include <dlfcn.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/if_link.h>
+#include <linux/netfilter/nfnetlink.h>
+#include <linux/netfilter/nfnetlink_conntrack.h>
+#include <linux/netfilter/nf_conntrack_tcp.h>
 
-#define STEP_COUNT	60
-#define STEP_TIME	1
-#define TIMEOUT		10
+#include <dlfcn.h>
 
-#define PID_PATH	"/var/run/luci-bwc.pid"
+#include "luci-bwc.h"
 
-#define DB_PATH		"/var/lib/luci-bwc"
-#define DB_IF_FILE	DB_PATH "/if/%s"
-#define DB_RD_FILE	DB_PATH "/radio/%s"
-#define DB_CN_FILE	DB_PATH "/connections"
-#define DB_LD_FILE	DB_PATH "/load"
+#define TIMEOUT		10
 
 #define IF_SCAN_PATTERN \
-	" %[^ :]:%u %u" \
+	" %[^ :]:%" SCNu64 " %" SCNu64 \
 	" %*d %*d %*d %*d %*d %*d" \
-	" %u %u"
+	" %" SCNu64 " %" SCNu64
 
-#define LD_SCAN_PATTERN \
-	"%f %f %f"
+#define NL_BUFSIZE	65536
 
 
-struct file_map {
-	int fd;
-	int size;
-	char *mmap;
+struct db_map {
+	struct db_map *next;
+	struct file_map map;
+	char path[];
 };
 
-struct traffic_entry {
-	uint32_t time;
-	uint32_t rxb;
-	uint32_t rxp;
-	uint32_t txb;
-	uint32_t txp;
+struct nl_sock {
+	int fd;
+	uint32_t seq;
 };
 
-struct conn_entry {
-	uint32_t time;
+struct cn_count {
 	uint32_t udp;
 	uint32_t tcp;
 	uint32_t other;
 };
 
-struct load_entry {
-	uint32_t time;
-	uint16_t load1;
-	uint16_t load5;
-	uint16_t load15;
+struct db_type {
+	int esize;
+	int legacy_esize;
+	void (*migrate)(void *entry, const void *legacy);
 };
 
-struct radio_entry {
+/* entry layout of version 1 databases without header */
+struct legacy_traffic_entry {
 	uint32_t time;
-	uint16_t rate;
-	uint8_t  rssi;
-	uint8_t  noise;
+	uint32_t rxb;
+	uint32_t rxp;
+	uint32_t txb;
+	uint32_t txp;
 };
 
-static int readpid(void)
-{
-	int fd;
-	int pid = -1;
-	char buf[9] = { 0 };
-
-	if ((fd = open(PID_PATH, O_RDONLY)) > -1)
-	{
-		if (read(fd, buf, sizeof(buf)))
-		{
-			buf[8] = 0;
-			pid = atoi(buf);
-		}
-
-		close(fd);
-	}
-
-	return pid;
-}
-
 static int writepid(void)
 {
 	int fd;
@@ -165,91 +132,233 @@ static int init_directory(char *path)
 	return 0;
 }
 
+/* consolidation tiers of new databases, the last sample of a step is kept */
+static const struct {
+	int count;
+	int step;
+} db_layout[DB_TIERS] = {
+	{ STEP_COUNT, STEP_TIME },
+	{ 60,         60        },
+	{ 24,         3600      },
+};
+
+static int dumptier = 0;
+static uint32_t dumpsince = 0;
+
 static int init_file(char *path, int esize)
 {
-	int i, file;
-	char buf[sizeof(struct traffic_entry)] = { 0 };
+	int i, file, off;
+	char tmp[1024];
+	struct db_header h;
 
 	if (init_directory(path))
 		return -1;
 
-	if ((file = open(path, O_WRONLY | O_CREAT, 0600)) >= 0)
+	memset(&h, 0, sizeof(h));
+	h.magic   = htonl(DB_MAGIC);
+	h.version = htons(DB_VERSION);
+	h.esize   = htons(esize);
+	h.ntiers  = htonl(DB_TIERS);
+
+	for (i = 0, off = sizeof(h); i < DB_TIERS; i++)
 	{
-		for (i = 0; i < STEP_COUNT; i++)
+		h.tiers[i].step   = htonl(db_layout[i].step);
+		h.tiers[i].count  = htonl(db_layout[i].count);
+		h.tiers[i].head   = htonl(db_layout[i].count - 1);
+		h.tiers[i].offset = htonl(off);
+
+		off += db_layout[i].count * esize;
+	}
+
+	/* build the file aside and move it into place, readers never see a
+	 * partially initialized database */
+	snprintf(tmp, sizeof(tmp), "%s.%d", path, getpid());
+
+	if ((file = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0600)) >= 0)
+	{
+		if ((write(file, &h, sizeof(h)) == sizeof(h)) &&
+		    !ftruncate(file, off) && !rename(tmp, path))
 		{
-			if (write(file, buf, esize) < 0)
-				break;
+			close(file);
+			return 0;
 		}
 
 		close(file);
-
-		return 0;
+		unlink(tmp);
 	}
 
 	return -1;
 }
 
-static inline uint32_t timeof(void *entry)
+/*
+ * Store the entry in every tier. An entry within the step of the most recent
+ * one replaces it, otherwise the head advances to the next slot. The entry is
+ * written before the head is moved, readers skip slots out of time order.
+ * If the clock stepped backwards, the entries newer than the given one are
+ * cleared so the tier stays in time order.
+ */
+static void db_insert(struct file_map *m, const void *entry)
 {
-	return ntohl(((struct traffic_entry *)entry)->time);
+	int i;
+	uint32_t j, now = timeof(entry);
+	uint32_t last, step, head;
+	struct db_header *h = (struct db_header *)m->mmap;
+	struct db_tier *t;
+
+	for (i = 0; i < ntohl(h->ntiers); i++)
+	{
+		t    = &h->tiers[i];
+		step = ntohl(t->step);
+		head = ntohl(t->head);
+		last = timeof(db_entry(m, t, head));
+
+		if (now < last)
+		{
+			for (j = 0; j < ntohl(t->count); j++)
+				if (timeof(db_entry(m, t, j)) > now)
+					memset(db_entry(m, t, j), 0, ntohs(h->esize));
+
+			last = 0;
+		}
+
+		if ((now / step) != (last / step))
+			head = (head + 1) % ntohl(t->count);
+
+		memcpy(db_entry(m, t, head), entry, ntohs(h->esize));
+		t->head = htonl(head);
+	}
 }
 
-static int update_file(const char *path, void *entry, int esize)
+/* Import the entries of a version 1 database */
+static void db_migrate(struct file_map *m, const struct db_type *type,
+                       const char *legacy)
 {
-	int rv = -1;
-	int file;
-	char *map;
+	int i;
+	char entry[sizeof(struct traffic_entry)];
+	const char *l;
 
-	if ((file = open(path, O_RDWR)) >= 0)
+	for (i = 0; i < STEP_COUNT; i++)
 	{
-		map = mmap(NULL, esize * STEP_COUNT, PROT_READ | PROT_WRITE,
-				   MAP_SHARED | MAP_LOCKED, file, 0);
+		l = legacy + i * type->legacy_esize;
 
-		if ((map != NULL) && (map != MAP_FAILED))
-		{
-			if (timeof(entry) > timeof(map + esize * (STEP_COUNT-1)))
-			{
-				memmove(map, map + esize, esize * (STEP_COUNT-1));
-				memcpy(map + esize * (STEP_COUNT-1), entry, esize);
-			}
+		if (!timeof(l))
+			continue;
+
+		if (type->migrate)
+			type->migrate(entry, l);
+		else
+			memcpy(entry, l, type->esize);
+
+		db_insert(m, entry);
+	}
+}
+
+static void migrate_traffic(void *entry, const void *legacy)
+{
+	struct traffic_entry *e = entry;
+	const struct legacy_traffic_entry *l = legacy;
+
+	memset(e, 0, sizeof(*e));
+
+	e->time = l->time;
+	e->rxb  = hton64(ntohl(l->rxb));
+	e->rxp  = hton64(ntohl(l->rxp));
+	e->txb  = hton64(ntohl(l->txb));
+	e->txp  = hton64(ntohl(l->txp));
+}
+
+static const struct db_type db_traffic = {
+	sizeof(struct traffic_entry), sizeof(struct legacy_traffic_entry),
+	migrate_traffic
+};
+
+static const struct db_type db_radio = {
+	sizeof(struct radio_entry), sizeof(struct radio_entry), NULL
+};
+
+static const struct db_type db_conn = {
+	sizeof(struct conn_entry), sizeof(struct conn_entry), NULL
+};
+
+static const struct db_type db_load = {
+	sizeof(struct load_entry), sizeof(struct load_entry), NULL
+};
+
+/* ring files written by the daemon, kept mapped for its whole lifetime */
+static struct db_map *db_maps = NULL;
+
+static struct file_map * map_db(const char *path, const struct db_type *type)
+{
+	struct db_map *db;
+	char *legacy = NULL;
+
+	for (db = db_maps; db; db = db->next)
+		if (!strcmp(db->path, path))
+			return &db->map;
+
+	if (!(db = malloc(sizeof(struct db_map) + strlen(path) + 1)))
+		return NULL;
+
+	strcpy(db->path, path);
+
+	if (mmap_file(path, 1, &db->map) || db_check(&db->map, type->esize))
+	{
+		/* keep the samples of a version 1 database */
+		if (db->map.mmap &&
+		    (db->map.size == STEP_COUNT * type->legacy_esize) &&
+		    (legacy = malloc(db->map.size)) != NULL)
+			memcpy(legacy, db->map.mmap, db->map.size);
 
-			munmap(map, esize * STEP_COUNT);
+		umap_file(&db->map);
 
-			rv = 0;
+		if (init_file(db->path, type->esize) ||
+		    mmap_file(path, 1, &db->map) ||
+		    db_check(&db->map, type->esize))
+		{
+			fprintf(stderr, "Failed to init %s: %s\n", path, strerror(errno));
+			umap_file(&db->map);
+			free(legacy);
+			free(db);
+			return NULL;
 		}
 
-		close(file);
+		if (legacy)
+		{
+			db_migrate(&db->map, type, legacy);
+			free(legacy);
+		}
 	}
 
-	return rv;
+	db->next = db_maps;
+	db_maps = db;
+
+	return &db->map;
 }
 
-static int mmap_file(const char *path, int esize, struct file_map *m)
+static void unmap_dbs(void)
 {
-	m->fd   = -1;
-	m->size = -1;
-	m->mmap = NULL;
+	struct db_map *db, *next;
 
-	if ((m->fd = open(path, O_RDONLY)) >= 0)
+	for (db = db_maps; db; db = next)
 	{
-		m->size = STEP_COUNT * esize;
-		m->mmap = mmap(NULL, m->size, PROT_READ,
-					   MAP_SHARED | MAP_LOCKED, m->fd, 0);
-
-		if ((m->mmap != NULL) && (m->mmap != MAP_FAILED))
-			return 0;
+		next = db->next;
+		umap_file(&db->map);
+		free(db);
 	}
 
-	return -1;
+	db_maps = NULL;
 }
 
-static void umap_file(struct file_map *m)
+static int update_file(const char *path, const struct db_type *type, void *entry)
 {
-	if ((m->mmap != NULL) && (m->mmap != MAP_FAILED))
-		munmap(m->mmap, m->size);
+	struct file_map *m;
+
+	if (!(m = map_db(path, type)))
+		return -1;
+
+	db_insert(m, entry);
 
-	if (m->fd > -1)
-		close(m->fd);
+	return 0;
 }
 
 static void * iwinfo_open(void)
@@ -311,33 +420,22 @@ static void iwinfo_close(void *iw)
 
 
 static int update_ifstat(
-	const char *ifname, uint32_t rxb, uint32_t rxp, uint32_t txb, uint32_t txp
+	const char *ifname, uint64_t rxb, uint64_t rxp, uint64_t txb, uint64_t txp
 ) {
 	char path[1024];
 
-	struct stat s;
 	struct traffic_entry e;
 
 	snprintf(path, sizeof(path), DB_IF_FILE, ifname);
 
-	if (stat(path, &s))
-	{
-		if (init_file(path, sizeof(struct traffic_entry)))
-		{
-			fprintf(stderr, "Failed to init %s: %s\n",
-					path, strerror(errno));
+	e.time     = htonl(time(NULL));
+	e.reserved = 0;
+	e.rxb      = hton64(rxb);
+	e.rxp      = hton64(rxp);
+	e.txb      = hton64(txb);
+	e.txp      = hton64(txp);
 
-			return -1;
-		}
-	}
-
-	e.time = htonl(time(NULL));
-	e.rxb  = htonl(rxb);
-	e.rxp  = htonl(rxp);
-	e.txb  = htonl(txb);
-	e.txp  = htonl(txp);
-
-	return update_file(path, &e, sizeof(struct traffic_entry));
+	return update_file(path, &db_traffic, &e);
 }
 
 static int update_radiostat(
@@ -345,99 +443,327 @@ static int update_radiostat(
 ) {
 	char path[1024];
 
-	struct stat s;
 	struct radio_entry e;
 
 	snprintf(path, sizeof(path), DB_RD_FILE, ifname);
 
-	if (stat(path, &s))
-	{
-		if (init_file(path, sizeof(struct radio_entry)))
-		{
-			fprintf(stderr, "Failed to init %s: %s\n",
-					path, strerror(errno));
-
-			return -1;
-		}
-	}
-
 	e.time  = htonl(time(NULL));
 	e.rate  = htons(rate);
 	e.rssi  = rssi;
 	e.noise = noise;
 
-	return update_file(path, &e, sizeof(struct radio_entry));
+	return update_file(path, &db_radio, &e);
 }
 
 static int update_cnstat(uint32_t udp, uint32_t tcp, uint32_t other)
 {
 	char path[1024];
 
-	struct stat s;
 	struct conn_entry e;
 
 	snprintf(path, sizeof(path), DB_CN_FILE);
 
-	if (stat(path, &s))
-	{
-		if (init_file(path, sizeof(struct conn_entry)))
-		{
-			fprintf(stderr, "Failed to init %s: %s\n",
-					path, strerror(errno));
-
-			return -1;
-		}
-	}
-
 	e.time  = htonl(time(NULL));
 	e.udp   = htonl(udp);
 	e.tcp   = htonl(tcp);
 	e.other = htonl(other);
 
-	return update_file(path, &e, sizeof(struct conn_entry));
+	return update_file(path, &db_conn, &e);
 }
 
 static int update_ldstat(uint16_t load1, uint16_t load5, uint16_t load15)
 {
 	char path[1024];
 
-	struct stat s;
 	struct load_entry e;
 
 	snprintf(path, sizeof(path), DB_LD_FILE);
 
-	if (stat(path, &s))
+	e.time   = htonl(time(NULL));
+	e.load1  = htons(load1);
+	e.load5  = htons(load5);
+	e.load15 = htons(load15);
+
+	return update_file(path, &db_load, &e);
+}
+
+static int nl_open(struct nl_sock *nl, int proto)
+{
+	struct sockaddr_nl sa = { .nl_family = AF_NETLINK };
+
+	nl->seq = time(NULL);
+
+	if ((nl->fd = socket(AF_NETLINK, SOCK_RAW, proto)) < 0)
+		return -1;
+
+	if (bind(nl->fd, (struct sockaddr *)&sa, sizeof(sa)) ||
+	    (fcntl(nl->fd, F_SETFD, FD_CLOEXEC) < 0))
 	{
-		if (init_file(path, sizeof(struct load_entry)))
+		close(nl->fd);
+		nl->fd = -1;
+		return -1;
+	}
+
+	return 0;
+}
+
+static void nl_close(struct nl_sock *nl)
+{
+	if (nl->fd > -1)
+		close(nl->fd);
+
+	nl->fd = -1;
+}
+
+/*
+ * Send a dump request and invoke cb for every reply message, returns 0 once
+ * the dump is complete and -1 on any error.
+ */
+static int nl_dump(struct nl_sock *nl, int type, void *req, int reqlen,
+                   void (*cb)(struct nlmsghdr *, void *), void *ctx)
+{
+	static char buf[NL_BUFSIZE];
+
+	struct nlmsghdr *hdr = (struct nlmsghdr *)buf;
+	struct sockaddr_nl sa = { .nl_family = AF_NETLINK };
+	int len;
+
+	if (nl->fd < 0)
+		return -1;
+
+	memset(buf, 0, NLMSG_SPACE(reqlen));
+	hdr->nlmsg_len   = NLMSG_LENGTH(reqlen);
+	hdr->nlmsg_type  = type;
+	hdr->nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+	hdr->nlmsg_seq   = ++nl->seq;
+	memcpy(NLMSG_DATA(hdr), req, reqlen);
+
+	if (sendto(nl->fd, buf, hdr->nlmsg_len, 0,
+	           (struct sockaddr *)&sa, sizeof(sa)) < 0)
+		return -1;
+
+	while (1)
+	{
+		if ((len = recv(nl->fd, buf, sizeof(buf), 0)) <= 0)
 		{
-			fprintf(stderr, "Failed to init %s: %s\n",
-					path, strerror(errno));
+			if ((len < 0) && (errno == EINTR))
+				continue;
 
 			return -1;
 		}
+
+		for (hdr = (struct nlmsghdr *)buf; NLMSG_OK(hdr, len);
+		     hdr = NLMSG_NEXT(hdr, len))
+		{
+			if (hdr->nlmsg_seq != nl->seq)
+				continue;
+
+			if (hdr->nlmsg_type == NLMSG_DONE)
+				return 0;
+
+			if (hdr->nlmsg_type == NLMSG_ERROR)
+				return -1;
+
+			cb(hdr, ctx);
+		}
 	}
+}
 
-	e.time   = htonl(time(NULL));
-	e.load1  = htons(load1);
-	e.load5  = htons(load5);
-	e.load15 = htons(load15);
+/* Find attribute of given type within the attribute stream at buf */
+static struct nlattr * nl_attr(void *buf, int len, int type)
+{
+	struct nlattr *attr;
+
+	for (attr = buf;
+	     (len >= (int)sizeof(*attr)) && (attr->nla_len >= sizeof(*attr)) &&
+	     (attr->nla_len <= len);
+	     len -= NLA_ALIGN(attr->nla_len),
+	     attr = (struct nlattr *)((char *)attr + NLA_ALIGN(attr->nla_len)))
+	{
+		if ((attr->nla_type & NLA_TYPE_MASK) == type)
+			return attr;
+	}
 
-	return update_file(path, &e, sizeof(struct load_entry));
+	return NULL;
 }
 
-static int run_daemon(void)
+#define nl_attr_data(attr) \
+	((void *)((char *)(attr) + NLA_HDRLEN))
+
+#define nl_attr_len(attr) \
+	((int)(attr)->nla_len - NLA_HDRLEN)
+
+#define nl_attr_nested(attr, type) \
+	((attr) ? nl_attr(nl_attr_data(attr), nl_attr_len(attr), type) : NULL)
+
+static void nl_link_cb(struct nlmsghdr *hdr, void *ctx)
+{
+	struct rtnl_link_stats64 st64;
+	struct rtnl_link_stats st;
+	struct nlattr *name, *stats;
+	char *attrs = (char *)NLMSG_DATA(hdr) + NLMSG_ALIGN(sizeof(struct ifinfomsg));
+	int len = (char *)hdr + hdr->nlmsg_len - attrs;
+
+	if ((hdr->nlmsg_type != RTM_NEWLINK) || (len < 0) ||
+	    !(name = nl_attr(attrs, len, IFLA_IFNAME)) ||
+	    !strncmp(nl_attr_data(name), "lo", nl_attr_len(name)))
+		return;
+
+	/* attribute payloads are only 32bit aligned, copy them out */
+	if ((stats = nl_attr(attrs, len, IFLA_STATS64)) != NULL &&
+	    (nl_attr_len(stats) >= sizeof(st64)))
+	{
+		memcpy(&st64, nl_attr_data(stats), sizeof(st64));
+		update_ifstat(nl_attr_data(name),
+		              st64.rx_bytes, st64.rx_packets,
+		              st64.tx_bytes, st64.tx_packets);
+	}
+	else if ((stats = nl_attr(attrs, len, IFLA_STATS)) != NULL &&
+	         (nl_attr_len(stats) >= sizeof(st)))
+	{
+		memcpy(&st, nl_attr_data(stats), sizeof(st));
+		update_ifstat(nl_attr_data(name),
+		              st.rx_bytes, st.rx_packets,
+		              st.tx_bytes, st.tx_packets);
+	}
+}
+
+static int nl_update_ifstats(struct nl_sock *nl)
+{
+	struct ifinfomsg ifi = { .ifi_family = AF_UNSPEC };
+
+	return nl_dump(nl, RTM_GETLINK, &ifi, sizeof(ifi), nl_link_cb, NULL);
+}
+
+static void nl_conn_cb(struct nlmsghdr *hdr, void *ctx)
+{
+	struct cn_count *c = ctx;
+	struct nlattr *proto, *state;
+	char *attrs = (char *)NLMSG_DATA(hdr) + NLMSG_ALIGN(sizeof(struct nfgenmsg));
+	int len = (char *)hdr + hdr->nlmsg_len - attrs;
+
+	if (len < 0)
+		return;
+
+	proto = nl_attr_nested(nl_attr_nested(nl_attr(attrs, len,
+		CTA_TUPLE_ORIG), CTA_TUPLE_PROTO), CTA_PROTO_NUM);
+
+	if (!proto)
+		c->other++;
+
+	else if (*(uint8_t *)nl_attr_data(proto) == IPPROTO_UDP)
+		c->udp++;
+
+	else if (*(uint8_t *)nl_attr_data(proto) == IPPROTO_TCP)
+	{
+		state = nl_attr_nested(nl_attr_nested(nl_attr(attrs, len,
+			CTA_PROTOINFO), CTA_PROTOINFO_TCP), CTA_PROTOINFO_TCP_STATE);
+
+		if (!state ||
+		    (*(uint8_t *)nl_attr_data(state) != TCP_CONNTRACK_TIME_WAIT))
+			c->tcp++;
+	}
+
+	else
+		c->other++;
+}
+
+static int nl_update_cnstat(struct nl_sock *nl)
+{
+	struct cn_count c = { 0, 0, 0 };
+	struct nfgenmsg nfg = {
+		.nfgen_family = AF_UNSPEC,
+		.version      = NFNETLINK_V0
+	};
+
+	if (nl_dump(nl, (NFNL_SUBSYS_CTNETLINK << 8) | IPCTNL_MSG_CT_GET,
+	            &nfg, sizeof(nfg), nl_conn_cb, &c))
+		return -1;
+
+	return update_cnstat(c.udp, c.tcp, c.other);
+}
+
+static int proc_update_ifstats(void)
 {
 	FILE *info;
-	uint32_t rxb, txb, rxp, txp;
-	uint32_t udp, tcp, other;
+	uint64_t rxb, txb, rxp, txp;
+	char line[1024];
+	char ifname[16];
+
+	if ((info = fopen("/proc/net/dev", "r")) == NULL)
+		return -1;
+
+	while (fgets(line, sizeof(line), info))
+	{
+		if (strchr(line, '|'))
+			continue;
+
+		if (sscanf(line, IF_SCAN_PATTERN, ifname, &rxb, &rxp, &txb, &txp))
+		{
+			if (strncmp(ifname, "lo", sizeof(ifname)))
+				update_ifstat(ifname, rxb, rxp, txb, txp);
+		}
+	}
+
+	fclose(info);
+
+	return 0;
+}
+
+static int proc_update_cnstat(const char *ipc)
+{
+	FILE *info;
+	struct cn_count c = { 0, 0, 0 };
+	char line[1024];
+	char proto[16];
+
+	if ((info = fopen(ipc, "r")) == NULL)
+		return -1;
+
+	while (fgets(line, sizeof(line), info))
+	{
+		if (strstr(line, "TIME_WAIT"))
+			continue;
+
+		if (sscanf(line, "%*s %*d %15s", proto) ||
+		    sscanf(line, "%15s %*d", proto))
+		{
+			if (!strcmp(proto, "tcp"))
+				c.tcp++;
+			else if (!strcmp(proto, "udp"))
+				c.udp++;
+			else
+				c.other++;
+		}
+	}
+
+	fclose(info);
+
+	return update_cnstat(c.udp, c.tcp, c.other);
+}
+
+static int update_load(void)
+{
+	struct sysinfo si;
+
+	if (sysinfo(&si))
+		return -1;
+
+	/* load averages are fixed point values with 16 bit fraction */
+	return update_ldstat((uint16_t)((si.loads[0] * 100) >> SI_LOAD_SHIFT),
+	                     (uint16_t)((si.loads[1] * 100) >> SI_LOAD_SHIFT),
+	                     (uint16_t)((si.loads[2] * 100) >> SI_LOAD_SHIFT));
+}
+
+static int run_daemon(void)
+{
 	uint16_t rate;
 	uint8_t rssi, noise;
-	float lf1, lf5, lf15;
-	char line[1024];
 	char ifname[16];
 	int i;
 	void *iw;
 	struct sigaction sa;
+	struct nl_sock rtnl, ctnl;
 
 	struct stat s;
 	const char *ipc = stat("/proc/net/nf_conntrack", &s)
@@ -481,6 +807,10 @@ static int run_daemon(void)
 	/* initialize iwinfo */
 	iw = iwinfo_open();
 
+	/* initialize netlink, the /proc files are used as fallback */
+	nl_open(&rtnl, NETLINK_ROUTE);
+	nl_open(&ctnl, NETLINK_NETFILTER);
+
 	/* go */
 	for (reset_countdown(0); countdown >= 0; countdown--)
 	{
@@ -488,22 +818,9 @@ static int run_daemon(void)
 		memset(progname, 0, prognamelen);
 		snprintf(progname, prognamelen, "luci-bwc %d", countdown);
 
-		if ((info = fopen("/proc/net/dev", "r")) != NULL)
-		{
-			while (fgets(line, sizeof(line), info))
-			{
-				if (strchr(line, '|'))
-					continue;
-
-				if (sscanf(line, IF_SCAN_PATTERN, ifname, &rxb, &rxp, &txb, &txp))
-				{
-					if (strncmp(ifname, "lo", sizeof(ifname)))
-						update_ifstat(ifname, rxb, rxp, txb, txp);
-				}
-			}
-
-			fclose(info);
-		}
+		/* link statistics, prefer rtnetlink over parsing /proc/net/dev */
+		if (nl_update_ifstats(&rtnl))
+			proc_update_ifstats();
 
 		if (iw)
 		{
@@ -525,44 +842,11 @@ static int run_daemon(void)
 			}
 		}
 
-		if ((info = fopen(ipc, "r")) != NULL)
-		{
-			udp   = 0;
-			tcp   = 0;
-			other = 0;
-
-			while (fgets(line, sizeof(line), info))
-			{
-				if (strstr(line, "TIME_WAIT"))
-					continue;
-
-				if (sscanf(line, "%*s %*d %s", ifname) || sscanf(line, "%s %*d", ifname))
-				{
-					if (!strcmp(ifname, "tcp"))
-						tcp++;
-					else if (!strcmp(ifname, "udp"))
-						udp++;
-					else
-						other++;
-				}
-			}
-
-			update_cnstat(udp, tcp, other);
+		/* conntrack counts, prefer ctnetlink over parsing the table text */
+		if (nl_update_cnstat(&ctnl))
+			proc_update_cnstat(ipc);
 
-			fclose(info);
-		}
-
-		if ((info = fopen("/proc/loadavg", "r")) != NULL)
-		{
-			if (fscanf(info, LD_SCAN_PATTERN, &lf1, &lf5, &lf15))
-			{
-				update_ldstat((uint16_t)(lf1  * 100),
-							  (uint16_t)(lf5  * 100),
-							  (uint16_t)(lf15 * 100));
-			}
-
-			fclose(info);
-		}
+		update_load();
 
 		sleep(STEP_TIME);
 	}
@@ -572,6 +856,10 @@ static int run_daemon(void)
 	if (iw)
 		iwinfo_close(iw);
 
+	nl_close(&rtnl);
+	nl_close(&ctnl);
+	unmap_dbs();
+
 	return 0;
 }
 
@@ -598,140 +886,89 @@ static void check_daemon(void)
 	}
 }
 
-static int run_dump_ifname(const char *ifname)
+static int run_dump(const char *path, const struct db_type *type,
+                    int (*format)(char *, int, const void *))
 {
-	int i;
-	char path[1024];
+	int i, n;
+	uint32_t last;
 	struct file_map m;
-	struct traffic_entry *e;
+	char *e;
+	char line[128];
 
 	check_daemon();
-	snprintf(path, sizeof(path), DB_IF_FILE, ifname);
 
-	if (mmap_file(path, sizeof(struct traffic_entry), &m))
+	if (mmap_file(path, 0, &m) || db_check(&m, type->esize))
 	{
 		fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+		umap_file(&m);
 		return 1;
 	}
 
-	for (i = 0; i < m.size; i += sizeof(struct traffic_entry))
+	if (dumptier >= ntohl(((struct db_header *)m.mmap)->ntiers))
 	{
-		e = (struct traffic_entry *) &m.mmap[i];
-
-		if (!e->time)
-			continue;
-
-		printf("[ %u, %u, %" PRIu32
-			   ", %u, %u ]%s\n",
-			ntohl(e->time),
-			ntohl(e->rxb), ntohl(e->rxp),
-			ntohl(e->txb), ntohl(e->txp),
-			((i + sizeof(struct traffic_entry)) < m.size) ? "," : "");
-	}
-
-	umap_file(&m);
-
-	return 0;
-}
-
-static int run_dump_radio(const char *ifname)
-{
-	int i;
-	char path[1024];
-	struct file_map m;
-	struct radio_entry *e;
-
-	check_daemon();
-	snprintf(path, sizeof(path), DB_RD_FILE, ifname);
-
-	if (mmap_file(path, sizeof(struct radio_entry), &m))
-	{
-		fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+		fprintf(stderr, "No such tier in %s: %d\n", path, dumptier);
+		umap_file(&m);
 		return 1;
 	}
 
-	for (i = 0; i < m.size; i += sizeof(struct radio_entry))
+	for (i = 0, n = 0, last = dumpsince; (e = db_next(&m, dumptier, &i, &last)) != NULL; n++)
 	{
-		e = (struct radio_entry *) &m.mmap[i];
+		if (n)
+			printf(",\n");
 
-		if (!e->time)
-			continue;
-
-		printf("[ %u, %d, %d, %d ]%s\n",
-			ntohl(e->time),
-			e->rate, e->rssi, e->noise,
-			((i + sizeof(struct radio_entry)) < m.size) ? "," : "");
+		format(line, sizeof(line), e);
+		fputs(line, stdout);
 	}
 
+	if (n)
+		printf("\n");
+
 	umap_file(&m);
 
 	return 0;
 }
 
-static int run_dump_conns(void)
+static int run_dump_ifname(const char *ifname)
 {
-	int i;
 	char path[1024];
-	struct file_map m;
-	struct conn_entry *e;
-
-	check_daemon();
-	snprintf(path, sizeof(path), DB_CN_FILE);
 
-	if (mmap_file(path, sizeof(struct conn_entry), &m))
-	{
-		fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
-		return 1;
-	}
+	snprintf(path, sizeof(path), DB_IF_FILE, ifname);
 
-	for (i = 0; i < m.size; i += sizeof(struct conn_entry))
-	{
-		e = (struct conn_entry *) &m.mmap[i];
+	return run_dump(path, &db_traffic, format_traffic);
+}
 
-		if (!e->time)
-			continue;
+static int run_dump_radio(const char *ifname)
+{
+	char path[1024];
 
-		printf("[ %u, %u, %u, %u ]%s\n",
-			ntohl(e->time), ntohl(e->udp),
-			ntohl(e->tcp), ntohl(e->other),
-			((i + sizeof(struct conn_entry)) < m.size) ? "," : "");
-	}
+	snprintf(path, sizeof(path), DB_RD_FILE, ifname);
 
-	umap_file(&m);
+	return run_dump(path, &db_radio, format_radio);
+}
 
-	return 0;
+static int run_dump_conns(void)
+{
+	return run_dump(DB_CN_FILE, &db_conn, format_conns);
 }
 
 static int run_dump_load(void)
 {
-	int i;
-	char path[1024];
-	struct file_map m;
-	struct load_entry *e;
-
-	check_daemon();
-	snprintf(path, sizeof(path), DB_LD_FILE);
-
-	if (mmap_file(path, sizeof(struct load_entry), &m))
-	{
-		fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
-		return 1;
-	}
+	return run_dump(DB_LD_FILE, &db_load, format_load);
+}
 
-	for (i = 0; i < m.size; i += sizeof(struct load_entry))
-	{
-		e = (struct load_entry *) &m.mmap[i];
+static void write_stdout(void *ctx, const char *data, int len)
+{
+	fwrite(data, 1, len, stdout);
+}
 
-		if (!e->time)
-			continue;
+static int run_export(const char **names, int count)
+{
+	check_daemon();
 
-		printf("[ %u, %u, %u, %u ]%s\n",
-			ntohl(e->time),
-			ntohs(e->load1), ntohs(e->load5), ntohs(e->load15),
-			((i + sizeof(struct load_entry)) < m.size) ? "," : "");
-	}
+	db_export(count ? names : NULL, count, dumptier, dumpsince,
+	          write_stdout, NULL);
 
-	umap_file(&m);
+	printf("\n");
 
 	return 0;
 }
@@ -740,6 +977,7 @@ static int run_dump_load(void)
 int main(int argc, char *argv[])
 {
 	int opt;
+	int export = 0;
 
 	progname = argv[0];
 	prognamelen = -1;
@@ -747,7 +985,7 @@ int main(int argc, char *argv[])
 	for (opt = 0; opt < argc; opt++)
 		prognamelen += 1 + strlen(argv[opt]);
 
-	while ((opt = getopt(argc, argv, "t:i:r:cl")) > -1)
+	while ((opt = getopt(argc, argv, "t:T:s:i:r:clpe")) > -1)
 	{
 		switch (opt)
 		{
@@ -755,6 +993,18 @@ int main(int argc, char *argv[])
 				timeout = atoi(optarg);
 				break;
 
+			case 'T':
+				dumptier = atoi(optarg);
+				break;
+
+			case 's':
+				dumpsince = strtoul(optarg, NULL, 10);
+				break;
+
+			case 'e':
+				export = 1;
+				break;
+
 			case 'i':
 				if (optarg)
 					return run_dump_ifname(optarg);
@@ -768,6 +1018,10 @@ int main(int argc, char *argv[])
 			case 'c':
 				return run_dump_conns();
 
+			case 'p':
+				check_daemon();
+				return 0;
+
 			case 'l':
 				return run_dump_load();
 
@@ -776,13 +1030,23 @@ int main(int argc, char *argv[])
 		}
 	}
 
+	if (export)
+		return run_export((const char **)&argv[optind], argc - optind);
+
 	fprintf(stderr,
 		"Usage:\n"
-		"	%s [-t timeout] -i ifname\n"
-		"	%s [-t timeout] -r radiodev\n"
-		"	%s [-t timeout] -c\n"
-		"	%s [-t timeout] -l\n",
-			argv[0], argv[0], argv[0], argv[0]
+		"	%s [-t timeout] [-T tier] [-s since] -i ifname\n"
+		"	%s [-t timeout] [-T tier] [-s since] -r radiodev\n"
+		"	%s [-t timeout] [-T tier] [-s since] -c\n"
+		"	%s [-t timeout] [-T tier] [-s since] -l\n"
+		"	%s [-t timeout] [-T tier] [-s since] -e [series ...]\n"
+		"	%s [-t timeout] -p\n"
+		"\n"
+		"Series: if/<ifname>, radio/<radiodev>, connections, load;\n"
+		"all existing series are exported if none is given.\n"
+		"Tiers: 0 = %ds steps, 1 = %ds steps, 2 = %ds steps\n",
+			argv[0], argv[0], argv[0], argv[0], argv[0], argv[0],
+			db_layout[0].step, db_layout[1].step, db_layout[2].step
 	);
 
 	return 1;
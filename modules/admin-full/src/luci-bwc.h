@@ -0,0 +1,160 @@
+/*
+ * luci-bwc - Very simple bandwidth collector cache for LuCI realtime graphs
+ *
+ * Database format and access functions shared by the collector and the
+ * Lua binding
+ *
+ *   Copyright (C) 2010 Jo-Philipp Wich <xm@subsignal.org>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LUCI_BWC_H_
+#define _LUCI_BWC_H_
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <arpa/inet.h>
+
+#define STEP_COUNT	60
+#define STEP_TIME	1
+
+#define DB_MAGIC	0x6c627763	/* "lbwc" */
+#define DB_VERSION	2
+#define DB_TIERS	3
+
+#define BWC_PATH	"/usr/bin/luci-bwc"
+#define PID_PATH	"/var/run/luci-bwc.pid"
+
+#define DB_PATH		"/var/lib/luci-bwc"
+#define DB_IF_FILE	DB_PATH "/if/%s"
+#define DB_RD_FILE	DB_PATH "/radio/%s"
+#define DB_CN_FILE	DB_PATH "/connections"
+#define DB_LD_FILE	DB_PATH "/load"
+
+
+struct file_map {
+	int fd;
+	int size;
+	char *mmap;
+};
+
+/*
+ * Database layout: a header followed by the entries of each tier. Every
+ * tier is a ring of count entries, head points to the most recent one.
+ * All values are stored in network byte order.
+ */
+struct db_tier {
+	uint32_t step;
+	uint32_t count;
+	uint32_t head;
+	uint32_t offset;
+};
+
+struct db_header {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t esize;
+	uint32_t ntiers;
+	uint32_t reserved;
+	struct db_tier tiers[DB_TIERS];
+};
+
+struct traffic_entry {
+	uint32_t time;
+	uint32_t reserved;
+	uint64_t rxb;
+	uint64_t rxp;
+	uint64_t txb;
+	uint64_t txp;
+};
+
+struct conn_entry {
+	uint32_t time;
+	uint32_t udp;
+	uint32_t tcp;
+	uint32_t other;
+};
+
+struct load_entry {
+	uint32_t time;
+	uint16_t load1;
+	uint16_t load5;
+	uint16_t load15;
+};
+
+struct radio_entry {
+	uint32_t time;
+	uint16_t rate;
+	uint8_t  rssi;
+	uint8_t  noise;
+};
+
+static inline uint64_t hton64(uint64_t v)
+{
+	uint32_t w[2] = { htonl(v >> 32), htonl(v & 0xFFFFFFFF) };
+	memcpy(&v, w, sizeof(v));
+	return v;
+}
+
+static inline uint64_t ntoh64(uint64_t v)
+{
+	uint32_t w[2];
+	memcpy(w, &v, sizeof(v));
+	return ((uint64_t)ntohl(w[0]) << 32) | ntohl(w[1]);
+}
+
+static inline uint32_t timeof(const void *entry)
+{
+	return ntohl(*(const uint32_t *)entry);
+}
+
+static inline char * db_entry(struct file_map *m, struct db_tier *t, int i)
+{
+	struct db_header *h = (struct db_header *)m->mmap;
+
+	return m->mmap + ntohl(t->offset) + i * ntohs(h->esize);
+}
+
+
+int readpid(void);
+
+int mmap_file(const char *path, int rw, struct file_map *m);
+void umap_file(struct file_map *m);
+
+int db_check(struct file_map *m, int esize);
+char * db_next(struct file_map *m, int tier, int *pos, uint32_t *last);
+
+int format_traffic(char *buf, int len, const void *entry);
+int format_radio(char *buf, int len, const void *entry);
+int format_conns(char *buf, int len, const void *entry);
+int format_load(char *buf, int len, const void *entry);
+
+typedef void (*db_write_t)(void *ctx, const char *data, int len);
+
+int db_dump(const char *name, int tier, uint32_t since,
+            db_write_t write, void *ctx);
+
+void db_export(const char **names, int count, int tier, uint32_t since,
+               db_write_t write, void *ctx);
+
+#endif
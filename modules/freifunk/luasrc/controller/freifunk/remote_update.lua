@@ -14,6 +14,7 @@ You may obtain a copy of the License at
 module("luci.controller.freifunk.remote_update", package.seeall)
 
 function index()
+	treedepend("/usr/sbin")
 	if not nixio.fs.access("/usr/sbin/remote-update") then
 		return
 	end